@@ -162,10 +162,13 @@ namespace BearLib
         TK_WCHAR            = 0xC9, // Unicode codepoint of last produced character
         TK_EVENT            = 0xCA, // Last dequeued event
         TK_FULLSCREEN       = 0xCB, // Fullscreen state
+        TK_TILESET_OFFSET   = 0xCC, // Offset of the tileset of the last TK_TILESET_LOADED event
+        TK_TILESET_STATUS   = 0xCD, // 1 if that tileset was loaded and applied, 0 if loading it failed
 
         // Other events
         TK_CLOSE            = 0xE0,
         TK_RESIZED          = 0xE1,
+        TK_TILESET_LOADED   = 0xE2,
 
         // Input result codes for terminal_read function.
         TK_INPUT_NONE       =    0,
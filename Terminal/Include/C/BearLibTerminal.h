@@ -230,6 +230,8 @@
 #define TK_WCHAR            0xC9 /**< Unicode codepoint of last produced character */
 #define TK_EVENT            0xCA /**< Last dequeued event */
 #define TK_FULLSCREEN       0xCB /**< Fullscreen state */
+#define TK_TILESET_OFFSET   0xCC /**< Offset of the tileset of the last TK_TILESET_LOADED event */
+#define TK_TILESET_STATUS   0xCD /**< 1 if that tileset was loaded and applied, 0 if loading it failed */
 /**
  * @}
  */
@@ -241,6 +243,7 @@
  */
 #define TK_CLOSE            0xE0
 #define TK_RESIZED          0xE1
+#define TK_TILESET_LOADED   0xE2 /**< Loading of a tileset requested with async=true has finished, see TK_TILESET_STATUS */
 /**
  * @}
  */
@@ -303,6 +306,25 @@ typedef struct dimensions_t_
 }
 dimensions_t;
 
+/**
+ * @struct print_record_t
+ * A string to print with terminal_print_batch8() and similar, along with the
+ * same placement arguments terminal_print_ext8() takes. The string is of 8-,
+ * 16- or 32-bit chars depending on the function. The printed size is written
+ * back to the size field.
+ */
+typedef struct print_record_t_
+{
+	int x;
+	int y;
+	int w;
+	int h;
+	int align;
+	const void* s;
+	dimensions_t size;
+}
+print_record_t;
+
 #if defined(BEARLIBTERMINAL_STATIC_BUILD)
 #  define TERMINAL_API
 #elif defined(_WIN32)
@@ -439,6 +461,22 @@ TERMINAL_API void terminal_clear();
  */
 TERMINAL_API void terminal_clear_area(int x, int y, int w, int h);
 
+/**
+ * @brief This function scrolls a part of the currently selected layer.
+ * @details The tiles within the area are moved by dx, dy cells; those moved
+ *          outside of the area are dropped. The cells uncovered by the move
+ *          are cleared as with terminal_clear_area(). When called on the first
+ *          layer, background colors are moved along with the tiles.
+ * @param[in] x x-coordinate of the area, from left to right
+ * @param[in] y y-coordinate of the area, from top to bottom
+ * @param[in] w Width
+ * @param[in] h Height
+ * @param[in] dx Horizontal shift in cells, positive to the right
+ * @param[in] dy Vertical shift in cells, positive downwards
+ * @sa terminal_layer()
+ */
+TERMINAL_API void terminal_scroll(int x, int y, int w, int h, int dx, int dy);
+
 /**
  * @brief This function sets a crop area of the current layer
  * @param[in] x x-coordinate of the area to crop, from left to right
@@ -475,6 +513,81 @@ TERMINAL_API void terminal_crop(int x, int y, int w, int h);
  */
 TERMINAL_API void terminal_layer(int index);
 
+/**
+ * @brief This function shifts the whole current layer by a number of pixels
+ *        when it is drawn.
+ * @details Unlike offsets of individual tiles set by terminal_put_ext(), the
+ *          layer offset is a single value that does not require putting the
+ *          tiles again, which makes it suitable for smooth scrolling and
+ *          camera panning. Background colors move with the first layer.
+ *          The crop area of the layer (see terminal_crop()) stays where it is,
+ *          so a scrolling view is usually drawn one row and column larger than
+ *          its crop area to have something to reveal at the edges.
+ *          The offset is reset by terminal_clear().
+ * @param[in] dx Horizontal offset in pixels, positive to the right
+ * @param[in] dy Vertical offset in pixels, positive downwards
+ * @sa terminal_layer()
+ */
+TERMINAL_API void terminal_layer_offset(int dx, int dy);
+
+/**
+ * @brief This function makes the current layer virtual: of its own size,
+ *        independent of the window, with only a part of it shown.
+ * @details All output and picking functions work in the coordinates of the
+ *          virtual layer. Which part of it is shown is set by
+ *          terminal_layer_origin(), so moving the camera over a large map does
+ *          not require putting it again. Memory is only allocated for the
+ *          parts of the layer that were drawn onto. Virtual layers keep their
+ *          contents when the window is resized.
+ * @param[in] width Width of the layer in cells, at most 16384
+ * @param[in] height Height of the layer in cells, at most 16384. If either
+ *                   dimension is 0, the layer is made the size of the window
+ *                   again
+ * @note The contents of the layer are cleared
+ * @note The first layer always matches the window since it has background
+ */
+TERMINAL_API void terminal_layer_size(int width, int height);
+
+/**
+ * @brief This function sets which cell of the current virtual layer is shown
+ *        at the top-left corner of the window.
+ * @details The origin is in cells and may be outside of the layer. Combined
+ *          with terminal_layer_offset() it allows smooth scrolling over a
+ *          large map. It has no effect on layers that are not virtual.
+ * @sa terminal_layer_size()
+ */
+TERMINAL_API void terminal_layer_origin(int x, int y);
+
+/**
+ * @brief This function saves the contents of a layer so that they can be
+ *        put back later with terminal_restore_layer().
+ * @details Taking a snapshot does not copy anything: the snapshot and the
+ *          layer share the tiles until the layer is modified. This makes it
+ *          cheap to save the scene under a popup and restore it once the
+ *          popup is closed instead of drawing everything again. A snapshot
+ *          of the first layer includes the background colors. Crop area and
+ *          offset of the layer are saved as well.
+ * @param[in] index Index of the layer, as with terminal_layer()
+ * @return Snapshot handle to be passed to terminal_restore_layer() and
+ *         released with terminal_release_snapshot() once no longer needed
+ * @note Snapshots taken before the window is resized cannot be restored
+ */
+TERMINAL_API int terminal_snapshot_layer(int index);
+
+/**
+ * @brief This function replaces the contents of the layer a snapshot was
+ *        taken of with that snapshot. The snapshot stays valid and can be
+ *        restored again.
+ * @param[in] snapshot Handle returned by terminal_snapshot_layer()
+ */
+TERMINAL_API void terminal_restore_layer(int snapshot);
+
+/**
+ * @brief This function frees a snapshot taken by terminal_snapshot_layer().
+ * @param[in] snapshot Handle returned by terminal_snapshot_layer()
+ */
+TERMINAL_API void terminal_release_snapshot(int snapshot);
+
 /**
  * @brief This function sets the current foreground color which will be used by
  *        all output functions called later.
@@ -585,6 +698,49 @@ TERMINAL_API void terminal_put(int x, int y, int code);
  */
 TERMINAL_API void terminal_put_ext(int x, int y, int dx, int dy, int code, color_t* corners);
 
+/**
+ * @brief Puts a rectangle of tiles in one call
+ * @details The result is the same as calling terminal_color(),
+ *          terminal_bkcolor() and terminal_put() for every cell of the
+ *          rectangle row by row, except that the current colors are left
+ *          unchanged. Cells outside of the window are skipped.
+ * @param[in] x x-coordinate of the top-left cell of the rectangle
+ * @param[in] y y-coordinate of the top-left cell of the rectangle
+ * @param[in] w Width of the rectangle
+ * @param[in] h Height of the rectangle
+ * @param[in] codes Codes to put, row by row; code 0 erases the cell as with
+ *                  terminal_put()
+ * @param[in] fg Foreground colors in the same layout as codes, or NULL to
+ *               use the current foreground color
+ * @param[in] bg Background colors in the same layout as codes, or NULL to
+ *               use the current background color. As with terminal_put(),
+ *               background is only painted on layer 0
+ * @param[in] stride Distance in elements between the starts of two rows of
+ *                   the arrays, or 0 if the rows are packed (stride is w)
+ */
+TERMINAL_API void terminal_put_array(int x, int y, int w, int h, const int* codes, const color_t* fg, const color_t* bg, int stride);
+
+/**
+ * @brief Fills a rectangle with the same tile
+ * @details The result is the same as calling terminal_put() for every cell of
+ *          the rectangle with the given colors set as current, except that
+ *          the current colors are left unchanged.
+ * @param[in] code The code to put; 0 erases the cells as with terminal_put()
+ * @param[in] fg Foreground color of the tiles
+ * @param[in] bg Background color of the cells, only painted on layer 0 and
+ *               only if not 0
+ */
+TERMINAL_API void terminal_fill(int x, int y, int w, int h, int code, color_t fg, color_t bg);
+
+/**
+ * @brief Sets the background color of a rectangle of cells without touching
+ *        the tiles in them
+ * @details Cell background is shared by all layers, so unlike terminal_put()
+ *          this works regardless of the current layer. Color 0 makes the
+ *          cells transparent.
+ */
+TERMINAL_API void terminal_fill_bkcolor(int x, int y, int w, int h, color_t bg);
+
 /**
  * @brief Returns the code of a symbol/tile in the specified cell of the current
  *        layer
@@ -715,6 +871,35 @@ TERMINAL_API void terminal_measure_ext16(int w, int h, const int16_t* s, int* ou
  */
 TERMINAL_API void terminal_measure_ext32(int w, int h, const int32_t* s, int* out_w, int* out_h);
 
+/**
+ * @brief Prints a number of strings in one call
+ * @details The result is the same as calling terminal_print_ext8() for each
+ *          record in order, but without the per-call overhead, which matters
+ *          most for language bindings printing many short strings per frame.
+ * @param[in,out] records The strings to print; the printed size of each one is
+ *                        written to its size field
+ * @param[in] count The number of records
+ */
+TERMINAL_API void terminal_print_batch8(print_record_t* records, int count);
+
+/** The same as terminal_print_batch8(), but the strings are of 16-bit chars */
+TERMINAL_API void terminal_print_batch16(print_record_t* records, int count);
+
+/** The same as terminal_print_batch8(), but the strings are of 32-bit chars */
+TERMINAL_API void terminal_print_batch32(print_record_t* records, int count);
+
+/**
+ * @brief The same as terminal_print_ext8(), but the string is formatted by
+ *        vsnprintf first
+ * @details The string is formatted into a buffer of the calling thread that
+ *          is reused by later calls and decoded straight from there, in
+ *          terminal.encoding like any other 8-bit string.
+ */
+TERMINAL_API void terminal_vprintf_ext8(int x, int y, int w, int h, int align, const int8_t* s, va_list args, int* out_w, int* out_h);
+
+/** The same as terminal_measure_ext8(), but the string is formatted the way terminal_vprintf_ext8() does it */
+TERMINAL_API void terminal_vmeasuref_ext8(int w, int h, const int8_t* s, va_list args, int* out_w, int* out_h);
+
 /**
  * @brief This function tells about input availability
  * @return true (non-zero) means that next read call will return a value
@@ -1006,18 +1191,45 @@ TERMINAL_API color_t color_from_name32(const int32_t* name);
 
 /*
  * These functions provide inline string formatting support
- * for terminal_setf, terminal_printf, etc.
+ * for terminal_setf, terminal_wprintf, etc. (8-bit terminal_printf and
+ * terminal_measuref are formatted by the library itself).
  *
- * Using static termporary buffer is okay because terminal API is not
- * required to be multiple-thread safe by design.
- */
+ * terminal_vsprintf and terminal_vswprintf only format the text into a
+ * temporary buffer. Where the compiler supports it the buffer is per thread,
+ * so these two may be used to prepare text on any thread. Functions that
+ * also print or measure it are not made any more thread-safe by this.
+ *
+ * A thread's buffer grows as needed up to TERMINAL_VSPRINTF_MAXIMUM_BUFFER_SIZE
+ * characters and is not freed when the thread exits.
+ */
+
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define TERMINAL_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TERMINAL_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define TERMINAL_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define TERMINAL_THREAD_LOCAL __thread
+#else
+#define TERMINAL_THREAD_LOCAL
+#endif
+
+/* va_copy is C99 and C++11, older compilers (C89, MSVC before 2013) may lack it */
+#if defined(va_copy)
+#define TERMINAL_VA_COPY(dst, src) va_copy(dst, src)
+#elif defined(__va_copy)
+#define TERMINAL_VA_COPY(dst, src) __va_copy(dst, src)
+#else
+#define TERMINAL_VA_COPY(dst, src) ((dst) = (src))
+#endif
 
 #define TERMINAL_VSPRINTF_MAXIMUM_BUFFER_SIZE 65536
 
 TERMINAL_INLINE const char* terminal_vsprintf(const char* s, va_list args)
 {
-	static int buffer_size = 512;
-	static char* buffer = NULL;
+	static TERMINAL_THREAD_LOCAL int buffer_size = 512;
+	static TERMINAL_THREAD_LOCAL char* buffer = NULL;
 	int rc = 0;
 
 	if (!s)
@@ -1027,8 +1239,11 @@ TERMINAL_INLINE const char* terminal_vsprintf(const char* s, va_list args)
 
 	while (1)
 	{
+		va_list attempt; /* args may be consumed by a failed attempt */
+		TERMINAL_VA_COPY(attempt, args);
 		buffer[buffer_size-1] = '\0';
-		rc = vsnprintf(buffer, buffer_size, s, args);
+		rc = vsnprintf(buffer, buffer_size, s, attempt);
+		va_end(attempt);
 		if (rc >= buffer_size || buffer[buffer_size-1] != '\0')
 		{
 			if (buffer_size >= TERMINAL_VSPRINTF_MAXIMUM_BUFFER_SIZE)
@@ -1048,8 +1263,8 @@ TERMINAL_INLINE const char* terminal_vsprintf(const char* s, va_list args)
 
 TERMINAL_INLINE const wchar_t* terminal_vswprintf(const wchar_t* s, va_list args)
 {
-	static int buffer_size = 512;
-	static wchar_t* buffer = NULL;
+	static TERMINAL_THREAD_LOCAL int buffer_size = 512;
+	static TERMINAL_THREAD_LOCAL wchar_t* buffer = NULL;
 	int rc = 0;
 
 	if (!s)
@@ -1059,13 +1274,17 @@ TERMINAL_INLINE const wchar_t* terminal_vswprintf(const wchar_t* s, va_list args
 
 	while (1)
 	{
+		va_list attempt; /* args may be consumed by a failed attempt */
+		TERMINAL_VA_COPY(attempt, args);
 		buffer[buffer_size-1] = L'\0';
 #if defined(_WIN32)
-		rc = _vsnwprintf(buffer, buffer_size, s, args);
+		rc = _vsnwprintf(buffer, buffer_size, s, attempt);
 #else
-		rc = vswprintf(buffer, buffer_size, s, args);
+		rc = vswprintf(buffer, buffer_size, s, attempt);
 #endif
-		if (rc >= buffer_size || buffer[buffer_size-1] != L'\0')
+		va_end(attempt);
+		/* Unlike vsnprintf, vswprintf fails with -1 when the buffer is too small */
+		if (rc < 0 || rc >= buffer_size || buffer[buffer_size-1] != L'\0')
 		{
 			if (buffer_size >= TERMINAL_VSPRINTF_MAXIMUM_BUFFER_SIZE)
 				return NULL;
@@ -1147,7 +1366,9 @@ TERMINAL_INLINE dimensions_t terminal_print(int x, int y, const char* s)
 
 TERMINAL_INLINE dimensions_t terminal_printf(int x, int y, const char* s, ...)
 {
-	TERMINAL_FORMATTED_WRAP(dimensions_t, terminal_print(x, y, terminal_vsprintf(s, args)))
+	dimensions_t ret;
+	TERMINAL_FORMATTED_WRAP_V(terminal_vprintf_ext8(x, y, 0, 0, TK_ALIGN_DEFAULT, (const int8_t*)s, args, &ret.width, &ret.height))
+	return ret;
 }
 
 TERMINAL_INLINE dimensions_t terminal_wprint(int x, int y, const wchar_t* s)
@@ -1172,7 +1393,9 @@ TERMINAL_INLINE dimensions_t terminal_print_ext(int x, int y, int w, int h, int
 
 TERMINAL_INLINE dimensions_t terminal_printf_ext(int x, int y, int w, int h, int align, const char* s, ...)
 {
-	TERMINAL_FORMATTED_WRAP(dimensions_t, terminal_print_ext(x, y, w, h, align, terminal_vsprintf(s, args)));
+	dimensions_t ret;
+	TERMINAL_FORMATTED_WRAP_V(terminal_vprintf_ext8(x, y, w, h, align, (const int8_t*)s, args, &ret.width, &ret.height))
+	return ret;
 }
 
 TERMINAL_INLINE dimensions_t terminal_wprint_ext(int x, int y, int w, int h, int align, const wchar_t* s)
@@ -1187,6 +1410,17 @@ TERMINAL_INLINE dimensions_t terminal_wprintf_ext(int x, int y, int w, int h, in
 	TERMINAL_FORMATTED_WRAP(dimensions_t, terminal_wprint_ext(x, y, w, h, align, terminal_vswprintf(s, args)))
 }
 
+/** @brief Just a wrapper of terminal_print_batch8() */
+TERMINAL_INLINE void terminal_print_batch(print_record_t* records, int count)
+{
+	terminal_print_batch8(records, count);
+}
+
+TERMINAL_INLINE void terminal_wprint_batch(print_record_t* records, int count)
+{
+	TERMINAL_CAT(terminal_print_batch, TERMINAL_WCHAR_SUFFIX)(records, count);
+}
+
 /** @brief Just a wrapper of terminal_measure_ext8() */
 TERMINAL_INLINE dimensions_t terminal_measure(const char* s)
 {
@@ -1197,7 +1431,9 @@ TERMINAL_INLINE dimensions_t terminal_measure(const char* s)
 
 TERMINAL_INLINE dimensions_t terminal_measuref(const char* s, ...)
 {
-	TERMINAL_FORMATTED_WRAP(dimensions_t, terminal_measure(terminal_vsprintf(s, args)))
+	dimensions_t ret;
+	TERMINAL_FORMATTED_WRAP_V(terminal_vmeasuref_ext8(0, 0, (const int8_t*)s, args, &ret.width, &ret.height))
+	return ret;
 }
 
 TERMINAL_INLINE dimensions_t terminal_wmeasure(const wchar_t* s)
@@ -1221,7 +1457,9 @@ TERMINAL_INLINE dimensions_t terminal_measure_ext(int w, int h, const char* s)
 
 TERMINAL_INLINE dimensions_t terminal_measuref_ext(int w, int h, const char* s, ...)
 {
-	TERMINAL_FORMATTED_WRAP(dimensions_t, terminal_measure_ext(w, h, terminal_vsprintf(s, args)))
+	dimensions_t ret;
+	TERMINAL_FORMATTED_WRAP_V(terminal_vmeasuref_ext8(w, h, (const int8_t*)s, args, &ret.width, &ret.height))
+	return ret;
 }
 
 TERMINAL_INLINE dimensions_t terminal_wmeasure_ext(int w, int h, const wchar_t* s)
@@ -163,26 +163,29 @@ const TK_KEY_RELEASED = 0x100
 // These can be accessed via terminal_state function.
 //
 const (
-	TK_WIDTH       = 0xC0 /* Terminal window size in cells */
-	TK_HEIGHT      = 0xC1
-	TK_CELL_WIDTH  = 0xC2 /* Character cell size in pixels */
-	TK_CELL_HEIGHT = 0xC3
-	TK_COLOR       = 0xC4 /* Current foregroung color */
-	TK_BKCOLOR     = 0xC5 /* Current background color */
-	TK_LAYER       = 0xC6 /* Current layer */
-	TK_COMPOSITION = 0xC7 /* Current composition state */
-	TK_CHAR        = 0xC8 /* Translated ANSI code of last produced character */
-	TK_WCHAR       = 0xC9 /* Unicode codepoint of last produced character */
-	TK_EVENT       = 0xCA /* Last dequeued event */
-	TK_FULLSCREEN  = 0xCB /* Fullscreen state */
+	TK_WIDTH          = 0xC0 /* Terminal window size in cells */
+	TK_HEIGHT         = 0xC1
+	TK_CELL_WIDTH     = 0xC2 /* Character cell size in pixels */
+	TK_CELL_HEIGHT    = 0xC3
+	TK_COLOR          = 0xC4 /* Current foregroung color */
+	TK_BKCOLOR        = 0xC5 /* Current background color */
+	TK_LAYER          = 0xC6 /* Current layer */
+	TK_COMPOSITION    = 0xC7 /* Current composition state */
+	TK_CHAR           = 0xC8 /* Translated ANSI code of last produced character */
+	TK_WCHAR          = 0xC9 /* Unicode codepoint of last produced character */
+	TK_EVENT          = 0xCA /* Last dequeued event */
+	TK_FULLSCREEN     = 0xCB /* Fullscreen state */
+	TK_TILESET_OFFSET = 0xCC /* Offset of the tileset of the last TK_TILESET_LOADED event */
+	TK_TILESET_STATUS = 0xCD /* 1 if that tileset was loaded and applied, 0 if loading it failed */
 )
 
 //
 // Other events
 //
 const (
-	TK_CLOSE   = 0xE0
-	TK_RESIZED = 0xE1
+	TK_CLOSE          = 0xE0
+	TK_RESIZED        = 0xE1
+	TK_TILESET_LOADED = 0xE2
 )
 
 //
@@ -159,10 +159,13 @@ const
   TK_WCHAR            = $C9; // Unicode codepoint of last produced character
   TK_EVENT            = $CA; // Last dequeued event
   TK_FULLSCREEN       = $CB; // Fullscreen state
+  TK_TILESET_OFFSET   = $CC; // Offset of the tileset of the last TK_TILESET_LOADED event
+  TK_TILESET_STATUS   = $CD; // 1 if that tileset was loaded and applied, 0 if loading it failed
 
   //Other events
   TK_CLOSE            = $E0;
   TK_RESIZED          = $E1;
+  TK_TILESET_LOADED   = $E2;
 
   // Generic mode enum.
   // Right now it is used for composition option only.
@@ -63,6 +63,7 @@ _library = _load_library()
 if ctypes.sizeof(ctypes.c_wchar()) == 4:
 	_wset = _library.terminal_set32
 	_wprint_ext = _library.terminal_print_ext32
+	_wprint_batch = _library.terminal_print_batch32
 	_wmeasure_ext = _library.terminal_measure_ext32
 	_read_wstr = _library.terminal_read_str32
 	_color_from_wname = _library.color_from_name32
@@ -71,6 +72,7 @@ if ctypes.sizeof(ctypes.c_wchar()) == 4:
 else:
 	_wset = _library.terminal_set16
 	_wprint_ext = _library.terminal_print_ext16
+	_wprint_batch = _library.terminal_print_batch16
 	_wmeasure_ext = _library.terminal_measure_ext16
 	_read_wstr = _library.terminal_read_str16
 	_color_from_wname = _library.color_from_name16
@@ -139,12 +141,32 @@ clear.restype = None
 clear_area = _library.terminal_clear_area
 clear_area.restype = None
 
+scroll = _library.terminal_scroll
+scroll.restype = None
+
 crop = _library.terminal_crop
 crop.restype = None
 
 layer = _library.terminal_layer
 layer.restype = None
 
+layer_offset = _library.terminal_layer_offset
+layer_offset.restype = None
+
+layer_size = _library.terminal_layer_size
+layer_size.restype = None
+
+layer_origin = _library.terminal_layer_origin
+layer_origin.restype = None
+
+snapshot_layer = _library.terminal_snapshot_layer
+
+restore_layer = _library.terminal_restore_layer
+restore_layer.restype = None
+
+release_snapshot = _library.terminal_release_snapshot
+release_snapshot.restype = None
+
 def color(v):
 	if isinstance(v, _integer):
 		_library.terminal_color(v)
@@ -187,6 +209,38 @@ def put_ext(x, y, dx, dy, c, corners=None):
 		_library.terminal_put_ext(x, y, dx, dy, c, ctypes.cast(put_ext.corners, ctypes.POINTER(ctypes.c_uint)))
 put_ext.corners = (c_uint32 * 4)()
 
+_put_array = _library.terminal_put_array
+_put_array.argtypes = [c_int, c_int, c_int, c_int, POINTER(c_int), POINTER(c_uint32), POINTER(c_uint32), c_int]
+_put_array.restype = None
+def put_array(x, y, width, height, codes, fg=None, bg=None, stride=0):
+	"""Puts a rectangle of tiles in one call. codes, fg and bg are sequences
+	(or ctypes arrays) laid out row by row; fg and bg may be omitted to use
+	the current colors."""
+	def to_array(values, kind, convert):
+		if values is None or isinstance(values, ctypes.Array):
+			return values
+		return (kind * len(values))(*[convert(v) for v in values])
+	codes = to_array(codes, c_int, lambda c: c if isinstance(c, _integer) else ord(c))
+	fg = to_array(fg, c_uint32, lambda c: c if isinstance(c, _integer) else color_from_name(c))
+	bg = to_array(bg, c_uint32, lambda c: c if isinstance(c, _integer) else color_from_name(c))
+	_put_array(x, y, width, height, codes, fg, bg, stride)
+
+def _to_color(v):
+	return v if isinstance(v, _integer) else color_from_name(v)
+
+_library.terminal_fill.argtypes = [c_int, c_int, c_int, c_int, c_int, c_uint32, c_uint32]
+_library.terminal_fill.restype = None
+_library.terminal_fill_bkcolor.argtypes = [c_int, c_int, c_int, c_int, c_uint32]
+_library.terminal_fill_bkcolor.restype = None
+
+def fill(x, y, width, height, c, fg, bg=0):
+	if not isinstance(c, _integer):
+		c = ord(c)
+	_library.terminal_fill(x, y, width, height, c, _to_color(fg), _to_color(bg))
+
+def fill_bkcolor(x, y, width, height, bg):
+	_library.terminal_fill_bkcolor(x, y, width, height, _to_color(bg))
+
 def pick(x, y, z = 0):
 	return _library.terminal_pick(x, y, z);
 
@@ -218,6 +272,33 @@ if _version3:
 def printf(x, y, s, *args):
 	return puts(x, y, s.format(*args))
 
+class _dimensions_t(ctypes.Structure):
+	_fields_ = [('width', c_int), ('height', c_int)]
+
+class _aprint_record_t(ctypes.Structure):
+	_fields_ = [('x', c_int), ('y', c_int), ('w', c_int), ('h', c_int), ('align', c_int), ('s', c_char_p), ('size', _dimensions_t)]
+
+class _wprint_record_t(ctypes.Structure):
+	_fields_ = [('x', c_int), ('y', c_int), ('w', c_int), ('h', c_int), ('align', c_int), ('s', c_wchar_p), ('size', _dimensions_t)]
+
+_aprint_batch = _library.terminal_print_batch8
+_aprint_batch.argtypes = [POINTER(_aprint_record_t), c_int]
+_aprint_batch.restype = None
+_wprint_batch.argtypes = [POINTER(_wprint_record_t), c_int]
+_wprint_batch.restype = None
+def print_batch(records):
+	"""Prints a sequence of (x, y, s) or (x, y, s, width, height, align) tuples
+	in one call and returns the list of printed sizes."""
+	records = list(records)
+	wide = _version3 or any(isinstance(r[2], unicode) for r in records)
+	array = ((_wprint_record_t if wide else _aprint_record_t) * len(records))()
+	for i, r in enumerate(records):
+		x, y, s = r[:3]
+		width, height, align = (list(r[3:6]) + [0, 0, 0])[:3]
+		array[i] = array._type_(x, y, width, height, align, s)
+	(_wprint_batch if wide else _aprint_batch)(array, len(records))
+	return [(a.size.width, a.size.height) for a in array]
+
 _ameasure_ext = _library.terminal_measure_ext8
 _ameasure_ext.argtypes = [c_int, c_int, c_char_p, POINTER(c_int), POINTER(c_int)]
 _ameasure_ext.restype = None
@@ -411,10 +492,13 @@ TK_CHAR             = 0xC8 # Translated ANSI code of last produced character
 TK_WCHAR            = 0xC9 # Unicode codepoint of last produced character
 TK_EVENT            = 0xCA # Last dequeued event
 TK_FULLSCREEN       = 0xCB # Fullscreen state
+TK_TILESET_OFFSET   = 0xCC # Offset of the tileset of the last TK_TILESET_LOADED event
+TK_TILESET_STATUS   = 0xCD # 1 if that tileset was loaded and applied, 0 if loading it failed
 
 # Other events.
 TK_CLOSE            = 0xE0
 TK_RESIZED          = 0xE1
+TK_TILESET_LOADED   = 0xE2
 
 # Generic mode enum. Used in Terminal.composition call only.
 TK_OFF              =    0
@@ -27,6 +27,7 @@
 #include "Geometry.hpp"
 #include "Utility.hpp"
 #include <algorithm>
+#include <unordered_set>
 #include <fstream>
 
 namespace BearLibTerminal
@@ -129,9 +130,42 @@ namespace BearLibTerminal
 		tileset(nullptr),
 		texture(nullptr),
 		alignment(TileAlignment::Center),
-		is_animated(false)
+		is_animated(false),
+		frame_count(1),
+		frame_duration(0)
 	{ }
 
+	Bitmap MakeFrameStrip(const std::vector<Bitmap>& frames)
+	{
+		Size size = frames.front().GetSize();
+		int count = (int)frames.size();
+		Bitmap result(Size{size.width * count + kFrameGutter * (count - 1), size.height}, Color{});
+
+		for (int i = 0; i < count; i++)
+		{
+			int left = i * (size.width + kFrameGutter);
+			result.Blit(frames[i], Point{left, 0});
+
+			for (int y = 0; y < size.height; y++)
+			{
+				if (i > 0)
+					result(left - 1, y) = frames[i](0, y);
+				if (i < count - 1)
+					result(left + size.width, y) = frames[i](size.width - 1, y);
+			}
+		}
+
+		return result;
+	}
+
+	static Size GetFrameSize(const TileInfo* tile)
+	{
+		Size size = tile->bitmap.GetSize();
+		if (tile->is_animated)
+			size.width = (size.width - kFrameGutter * (tile->frame_count - 1)) / tile->frame_count;
+		return size;
+	}
+
 
 
 	AtlasTexture::AtlasTexture(Size initial_size):
@@ -140,7 +174,7 @@ namespace BearLibTerminal
 		m_spaces.emplace_back(initial_size);
 	}
 
-	AtlasTexture::AtlasTexture(std::shared_ptr<TileInfo> sprite)
+	AtlasTexture::AtlasTexture(TileInfo* sprite)
 	{
 		Size size = sprite->bitmap.GetSize();
 		if (!g_has_texture_npot)
@@ -158,9 +192,9 @@ namespace BearLibTerminal
 
 		// Update the tile info.
 		sprite->texture = this;
-		sprite->useful_space = Rectangle{size};
+		sprite->useful_space = Rectangle{sprite->is_animated? GetFrameSize(sprite): size};
 		sprite->total_space = Rectangle{size};
-		sprite->texture_coords = CalcTexCoords(sprite->useful_space);
+		UpdateTexCoords(sprite);
 		m_tiles.push_back(sprite);
 	}
 
@@ -169,7 +203,7 @@ namespace BearLibTerminal
 		return m_tiles.empty();
 	}
 
-	bool AtlasTexture::Add(std::shared_ptr<TileInfo> tile)
+	bool AtlasTexture::Add(TileInfo* tile)
 	{
 		if (!tile)
 			throw std::runtime_error("Empty reference passed to AtlasTexture::Add");
@@ -266,9 +300,9 @@ namespace BearLibTerminal
 
 		// Update the tile info.
 		tile->texture = this;//shared_from_this();
-		tile->useful_space = Rectangle{location, bitmap_size};
+		tile->useful_space = Rectangle{location, GetFrameSize(tile)};
 		tile->total_space = Rectangle{location - Point{1, 1}, tile_size};
-		tile->texture_coords = CalcTexCoords(tile->useful_space);
+		UpdateTexCoords(tile);
 
 		// Save reference.
 		m_tiles.push_back(tile);
@@ -307,7 +341,7 @@ namespace BearLibTerminal
 
 		// Texture size has been changed, must recalculate texure coords for slots
 		for (auto& i: m_tiles)
-			i->texture_coords = CalcTexCoords(i->useful_space);
+			UpdateTexCoords(i);
 
 		return true;
 	}
@@ -329,7 +363,22 @@ namespace BearLibTerminal
 		};
 	}
 
-	void AtlasTexture::Remove(std::shared_ptr<TileInfo> tile, bool copy_bitmap_back)
+	void AtlasTexture::UpdateTexCoords(TileInfo* tile)
+	{
+		tile->texture_coords = CalcTexCoords(tile->useful_space);
+
+		if (tile->is_animated)
+		{
+			tile->frame_coords.clear();
+			for (int i = 0; i < tile->frame_count; i++)
+			{
+				Point shift{i * (tile->useful_space.width + kFrameGutter), 0};
+				tile->frame_coords.push_back(CalcTexCoords(tile->useful_space + shift));
+			}
+		}
+	}
+
+	void AtlasTexture::Remove(TileInfo* tile, bool copy_bitmap_back)
 	{
 		if (!tile)
 			throw std::runtime_error("Empty reference passed to AtlasTexture::Remove");
@@ -337,12 +386,36 @@ namespace BearLibTerminal
 		if (tile->texture != this)
 			throw std::runtime_error("AtlasTexture::Remove: tile does not belong to this texture");
 
-		if (copy_bitmap_back)
-			tile->bitmap = m_canvas.Extract(tile->useful_space);
-		tile->texture = nullptr;
-		tile->total_space = tile->useful_space = Rectangle{};
-		m_tiles.remove(tile);
-		m_spaces.push_back(tile->total_space);
+		Remove(std::vector<TileInfo*>{tile}, copy_bitmap_back);
+	}
+
+	void AtlasTexture::Remove(const std::vector<TileInfo*>& tiles, bool copy_bitmap_back)
+	{
+		std::unordered_set<TileInfo*> removed;
+		for (auto tile: tiles)
+		{
+			if (!tile)
+				throw std::runtime_error("Empty reference passed to AtlasTexture::Remove");
+
+			if (tile->texture != this)
+				throw std::runtime_error("AtlasTexture::Remove: tile does not belong to this texture");
+
+			if (copy_bitmap_back)
+				tile->bitmap = m_canvas.Extract(Rectangle{tile->useful_space.Location(), tile->is_animated? tile->bitmap.GetSize(): tile->useful_space.Size()});
+
+			// Freed area is not cleared nor uploaded: it will be overwritten
+			// (and marked dirty) when some other tile is placed there.
+			if (tile->total_space.Area() > 0)
+				m_spaces.push_back(tile->total_space);
+
+			tile->texture = nullptr;
+			tile->total_space = tile->useful_space = Rectangle{};
+			removed.insert(tile);
+		}
+
+		// Single pass over the tile list and a single space list re-sort for the whole batch.
+		m_tiles.remove_if([&](TileInfo* item){return removed.count(item) > 0;});
+		m_spaces.sort([](Rectangle& lhs, Rectangle& rhs){return lhs.Area() < rhs.Area();});
 	}
 
 	void AtlasTexture::Bind()
@@ -395,11 +468,14 @@ namespace BearLibTerminal
 
 
 
-	void Atlas::Add(std::shared_ptr<TileInfo> tile)
+	void Atlas::Add(TileInfo* tile)
 	{
 		if (!tile)
 			throw std::runtime_error("Empty reference passed to Atlas::Add");
 
+		if (tile->is_animated)
+			m_animated_tiles.insert(tile);
+
 		if (tile->bitmap.GetSize().Area() >= 100*100) // Arbitrary chosen size.
 		{
 			m_textures.push_back(std::make_shared<AtlasTexture>(tile));
@@ -419,14 +495,31 @@ namespace BearLibTerminal
 		}
 	}
 
-	void Atlas::Remove(std::shared_ptr<TileInfo> tile)
+	void Atlas::Remove(TileInfo* tile)
 	{
 		if (!tile || !tile->texture)
 			throw std::runtime_error("Empty reference passed to Atlas::Remove");
 
+		m_animated_tiles.erase(tile);
 		tile->texture->Remove(tile);
 	}
 
+	void Atlas::Remove(const std::vector<TileInfo*>& tiles, bool copy_bitmap_back)
+	{
+		// Group tiles by texture so that every texture is updated once.
+		std::map<AtlasTexture*, std::vector<TileInfo*>> batches;
+		for (auto tile: tiles)
+		{
+			if (tile && tile->texture)
+				batches[tile->texture].push_back(tile);
+
+			m_animated_tiles.erase(tile);
+		}
+
+		for (auto& batch: batches)
+			batch.first->Remove(batch.second, copy_bitmap_back);
+	}
+
 	void Atlas::Defragment()
 	{
 		for (auto& texture: m_textures)
@@ -441,6 +534,7 @@ namespace BearLibTerminal
 	void Atlas::Clear()
 	{
 		m_textures.clear();
+		m_animated_tiles.clear();
 	}
 
 	void Atlas::ApplyTextureFilter()
@@ -448,4 +542,14 @@ namespace BearLibTerminal
 		for (auto texture: m_textures)
 			texture->ApplyTextureFilter();
 	}
+
+	void Atlas::Animate(uint64_t time)
+	{
+		for (auto tile: m_animated_tiles)
+		{
+			// All tiles with the same frame duration stay in sync.
+			if (!tile->frame_coords.empty())
+				tile->texture_coords = tile->frame_coords[(time / tile->frame_duration) % tile->frame_count];
+		}
+	}
 }
@@ -31,9 +31,11 @@
 #include <ostream>
 #include <memory>
 #include <list>
+#include <vector>
 #include <set>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include "OptionGroup.hpp"
 
 namespace BearLibTerminal
@@ -76,16 +78,27 @@ namespace BearLibTerminal
 		Size spacing;
 		TileAlignment alignment;
 		bool is_animated;
+		int frame_count; // Animated tile bitmap is a strip of frames, see MakeFrameStrip
+		int frame_duration; // Milliseconds
+		std::vector<TexCoords> frame_coords;
 	};
 
+	// Lays out animation frames left to right with kFrameGutter pixels between them.
+	// Gutters repeat the frame edges so that neighbouring frames do not bleed into
+	// each other when the texture is sampled with filtering.
+	Bitmap MakeFrameStrip(const std::vector<Bitmap>& frames);
+
+	static const int kFrameGutter = 2;
+
 	class AtlasTexture
 	{
 	public:
 		AtlasTexture(Size initial_size);
-		AtlasTexture(std::shared_ptr<TileInfo> sprite);
+		AtlasTexture(TileInfo* sprite);
 		bool IsEmpty() const;
-		bool Add(std::shared_ptr<TileInfo> tile);
-		void Remove(std::shared_ptr<TileInfo> tile, bool copy_bitmap_back=false);
+		bool Add(TileInfo* tile);
+		void Remove(TileInfo* tile, bool copy_bitmap_back=false);
+		void Remove(const std::vector<TileInfo*>& tiles, bool copy_bitmap_back=false);
 		void Bind();
 		void Defragment();
 		void ApplyTextureFilter();
@@ -93,25 +106,29 @@ namespace BearLibTerminal
 	private:
 		bool TryGrow();
 		TexCoords CalcTexCoords(const Rectangle& region);
+		void UpdateTexCoords(TileInfo* tile);
 		Texture m_texture;
 		Bitmap m_canvas;
 		std::list<Rectangle> m_dirty_regions;
 		std::list<Rectangle> m_spaces;
-		std::list<std::shared_ptr<TileInfo>> m_tiles;
+		std::list<TileInfo*> m_tiles;
 	};
 
 	class Atlas
 	{
 	public:
-		void Add(std::shared_ptr<TileInfo> tile);
-		void Remove(std::shared_ptr<TileInfo> tile);
+		void Add(TileInfo* tile);
+		void Remove(TileInfo* tile);
+		void Remove(const std::vector<TileInfo*>& tiles, bool copy_bitmap_back=false);
 		void Defragment();
 		void CleanUp();
 		void Clear();
 		void ApplyTextureFilter();
+		void Animate(uint64_t time);
 
 	private:
 		std::list<std::shared_ptr<AtlasTexture>> m_textures;
+		std::unordered_set<TileInfo*> m_animated_tiles;
 	};
 
 	extern Atlas g_atlas;
@@ -30,6 +30,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 #include <string.h>
 #include <iostream>
 #include <thread>
@@ -94,7 +95,9 @@ int terminal_open()
 
 	Config::Instance().Reload();
 	Config::Instance().TryGet(L"ini.bearlibterminal.log.file", Log::Instance().filename);
-	Config::Instance().TryGet(L"ini.bearlibterminal.log.level", Log::Instance().level);
+	Log::Level level = Log::Instance().level;
+	if (Config::Instance().TryGet(L"ini.bearlibterminal.log.level", level))
+		Log::Instance().level = level;
 	Config::Instance().TryGet(L"ini.bearlibterminal.log.mode", Log::Instance().mode);
 
 	try
@@ -155,6 +158,48 @@ void terminal_clear_area(int x, int y, int w, int h)
 	g_instance->Clear(x, y, w, h);
 }
 
+void terminal_scroll(int x, int y, int w, int h, int dx, int dy)
+{
+	if (!g_instance) return;
+	g_instance->Scroll(x, y, w, h, dx, dy);
+}
+
+void terminal_layer_offset(int dx, int dy)
+{
+	if (!g_instance) return;
+	g_instance->SetLayerOffset(dx, dy);
+}
+
+void terminal_layer_size(int width, int height)
+{
+	if (!g_instance) return;
+	g_instance->SetLayerSize(width, height);
+}
+
+void terminal_layer_origin(int x, int y)
+{
+	if (!g_instance) return;
+	g_instance->SetLayerOrigin(x, y);
+}
+
+int terminal_snapshot_layer(int index)
+{
+	if (!g_instance) return 0;
+	return g_instance->SnapshotLayer(index);
+}
+
+void terminal_restore_layer(int snapshot)
+{
+	if (!g_instance) return;
+	g_instance->RestoreLayer(snapshot);
+}
+
+void terminal_release_snapshot(int snapshot)
+{
+	if (!g_instance) return;
+	g_instance->ReleaseSnapshot(snapshot);
+}
+
 void terminal_crop(int x, int y, int w, int h)
 {
 	if (!g_instance) return;
@@ -215,6 +260,24 @@ void terminal_put_ext(int x, int y, int dx, int dy, int code, color_t* corners)
 	g_instance->PutExtended(x, y, dx, dy, code, (BearLibTerminal::Color*)corners);
 }
 
+void terminal_put_array(int x, int y, int w, int h, const int* codes, const color_t* fg, const color_t* bg, int stride)
+{
+	if (!g_instance) return;
+	g_instance->PutArray(x, y, w, h, codes, (const BearLibTerminal::Color*)fg, (const BearLibTerminal::Color*)bg, stride);
+}
+
+void terminal_fill(int x, int y, int w, int h, int code, color_t fg, color_t bg)
+{
+	if (!g_instance) return;
+	g_instance->Fill(x, y, w, h, code, fg, bg);
+}
+
+void terminal_fill_bkcolor(int x, int y, int w, int h, color_t bg)
+{
+	if (!g_instance) return;
+	g_instance->FillBackColor(x, y, w, h, bg);
+}
+
 int terminal_pick(int x, int y, int index)
 {
 	if (!g_instance) return 0;
@@ -233,44 +296,106 @@ color_t terminal_pick_bkcolor(int x, int y)
 	return g_instance->PickBackColor(x, y);
 }
 
-#define TERMINAL_PRINT_OR_MEASURE(x, y, a, cast, measure) \
-	if (!g_instance || !s) { \
+#define TERMINAL_PRINT_OR_MEASURE(x, y, a, str, measure) \
+	if (!g_instance || !(str)) { \
 		if (out_w) *out_w = 0; \
 		if (out_h) *out_h = 0; \
 		return; \
 	} \
-	auto size = g_instance->Print(x, y, w, h, a, cast, false, measure); \
+	auto size = g_instance->Print(x, y, w, h, a, str, false, measure); \
 	if (out_w) *out_w = size.width; \
 	if (out_h) *out_h = size.height;
 
 void terminal_print_ext8(int x, int y, int w, int h, int align, const int8_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(x, y, align, g_instance->GetEncoding().Convert((const char*)s), false)
+	TERMINAL_PRINT_OR_MEASURE(x, y, align, (const char*)s, false)
 }
 
 void terminal_print_ext16(int x, int y, int w, int h, int align, const int16_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(x, y, align, BearLibTerminal::UCS2Encoding().Convert((const char16_t*)s), false)
+	TERMINAL_PRINT_OR_MEASURE(x, y, align, (const char16_t*)s, false)
 }
 
 void terminal_print_ext32(int x, int y, int w, int h, int align, const int32_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(x, y, align, BearLibTerminal::UCS4Encoding().Convert((const char32_t*)s), false)
+	TERMINAL_PRINT_OR_MEASURE(x, y, align, (const char32_t*)s, false)
 }
 
 void terminal_measure_ext8(int w, int h, const int8_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, g_instance->GetEncoding().Convert((const char*)s), true)
+	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, (const char*)s, true)
 }
 
 void terminal_measure_ext16(int w, int h, const int16_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, BearLibTerminal::UCS2Encoding().Convert((const char16_t*)s), true)
+	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, (const char16_t*)s, true)
 }
 
 void terminal_measure_ext32(int w, int h, const int32_t* s, int* out_w, int* out_h)
 {
-	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, BearLibTerminal::UCS4Encoding().Convert((const char32_t*)s), true)
+	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, (const char32_t*)s, true)
+}
+
+// Formats into a buffer of the calling thread that is reused by every call,
+// so it only allocates when the string is longer than any before it.
+static const char* format_thread_local(const int8_t* s, va_list args)
+{
+	static thread_local std::vector<char> buffer(512);
+
+	if (!s)
+		return nullptr;
+
+	va_list retry;
+	va_copy(retry, args);
+	int rc = vsnprintf(buffer.data(), buffer.size(), (const char*)s, args);
+	if (rc >= (int)buffer.size())
+	{
+		buffer.resize(rc+1);
+		rc = vsnprintf(buffer.data(), buffer.size(), (const char*)s, retry);
+	}
+	va_end(retry);
+
+	return rc >= 0? buffer.data(): nullptr;
+}
+
+void terminal_vprintf_ext8(int x, int y, int w, int h, int align, const int8_t* s, va_list args, int* out_w, int* out_h)
+{
+	const char* text = format_thread_local(s, args);
+	TERMINAL_PRINT_OR_MEASURE(x, y, align, text, false)
+}
+
+void terminal_vmeasuref_ext8(int w, int h, const int8_t* s, va_list args, int* out_w, int* out_h)
+{
+	const char* text = format_thread_local(s, args);
+	TERMINAL_PRINT_OR_MEASURE(0, 0, TK_ALIGN_DEFAULT, text, true)
+}
+
+template<typename CharT> static void print_batch(print_record_t* records, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		print_record_t& r = records[i];
+		Size size;
+		if (g_instance && r.s)
+			size = g_instance->Print(r.x, r.y, r.w, r.h, r.align, (const CharT*)r.s, false, false);
+		r.size.width = size.width;
+		r.size.height = size.height;
+	}
+}
+
+void terminal_print_batch8(print_record_t* records, int count)
+{
+	print_batch<char>(records, count);
+}
+
+void terminal_print_batch16(print_record_t* records, int count)
+{
+	print_batch<char16_t>(records, count);
+}
+
+void terminal_print_batch32(print_record_t* records, int count)
+{
+	print_batch<char32_t>(records, count);
 }
 
 int terminal_has_input()
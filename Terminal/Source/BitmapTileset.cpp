@@ -113,6 +113,20 @@ namespace BearLibTerminal
 		if (options.attributes.count(L"align") && !try_parse(options.attributes[L"align"], alignment))
 			throw std::runtime_error("BitmapTileset: failed to parse 'alignment' attribute");
 
+		int frames = 1;
+		if (options.attributes.count(L"frames") && !try_parse(options.attributes[L"frames"], frames))
+			throw std::runtime_error("BitmapTileset: failed to parse 'frames' attribute");
+
+		if (frames < 1)
+			throw std::runtime_error("BitmapTileset: 'frames' attribute must be positive");
+
+		int frame_duration = 100;
+		if (options.attributes.count(L"frame-duration") && !try_parse(options.attributes[L"frame-duration"], frame_duration))
+			throw std::runtime_error("BitmapTileset: failed to parse 'frame-duration' attribute");
+
+		if (frame_duration < 1)
+			throw std::runtime_error("BitmapTileset: 'frame-duration' attribute must be positive");
+
 		Size raw_size;
 		if (options.attributes.count(L"raw-size") && !try_parse(options.attributes[L"raw-size"], raw_size))
 			throw std::runtime_error("BitmapTileset: failed to parse 'raw-size' attribute");
@@ -138,7 +152,11 @@ namespace BearLibTerminal
 		}
 
 		if (!m_bounding_box_size.Area())
+		{
+			// Single (possibly animated) sprite: the image is a horizontal strip of its frames.
 			m_bounding_box_size = image.GetSize();
+			m_bounding_box_size.width /= frames;
+		}
 		else if (!Rectangle{image.GetSize()}.Contains(Rectangle{m_bounding_box_size}))
 			throw std::runtime_error("Bitmap tileset: bitmap is smaller than tile size");
 
@@ -153,7 +171,8 @@ namespace BearLibTerminal
 		}
 
 		Size image_size = image.GetSize();
-		int columns = image_size.width / source_tile_size.width;
+		// With animation every tile takes 'frames' consecutive cells of a row.
+		int columns = image_size.width / source_tile_size.width / frames;
 		int rows = image_size.height / source_tile_size.height;
 		Size grid_size = Size{columns, rows};
 		LOG(Debug, "Tileset has " << columns << "x" << rows << " tiles");
@@ -165,13 +184,19 @@ namespace BearLibTerminal
 			alignment = grid_size.Area() > 1? TileAlignment::Center: TileAlignment::TopLeft;
 		}
 
+		auto extract_cell = [&](int x, int y) -> Bitmap
+		{
+			Bitmap result = image.Extract(Rectangle{Point{x * source_tile_size.width, y * source_tile_size.height}, source_tile_size});
+			if (resize_to.Area())
+				result = result.Resize(resize_to, resize_filter, resize_mode);
+			return result;
+		};
+
 		auto keep_tile = [&](int x, int y, char32_t code)
 		{
 			auto tile = std::make_shared<TileInfo>();
 			tile->tileset = this;
-			tile->bitmap = image.Extract(Rectangle{Point{x * source_tile_size.width, y * source_tile_size.height}, source_tile_size});
-			if (resize_to.Area())
-				tile->bitmap = tile->bitmap.Resize(resize_to, resize_filter, resize_mode);
+			tile->bitmap = extract_cell(x * frames, y);
 			tile->spacing = m_spacing;
 			tile->alignment = alignment;
 			if (alignment == TileAlignment::Center)
@@ -185,6 +210,17 @@ namespace BearLibTerminal
 				tile->offset = Point(-center.x, -center.y);
 			}
 
+			if (frames > 1)
+			{
+				std::vector<Bitmap> strip{tile->bitmap};
+				for (int i = 1; i < frames; i++)
+					strip.push_back(extract_cell(x * frames + i, y));
+				tile->bitmap = MakeFrameStrip(strip);
+				tile->is_animated = true;
+				tile->frame_count = frames;
+				tile->frame_duration = frame_duration;
+			}
+
 			m_cache[code] = tile;
 		};
 
@@ -0,0 +1,87 @@
+/*
+* BearLibTerminal
+* Copyright (C) 2013-2017 Cfyz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+* of the Software, and to permit persons to whom the Software is furnished to do
+* so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+* COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+* IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Codespace.hpp"
+
+namespace BearLibTerminal
+{
+	Codespace g_codespace;
+
+	Codespace::Page::Page():
+		count(0)
+	{
+		tiles.fill(nullptr);
+	}
+
+	Codespace::Codespace()
+	{ }
+
+	void Codespace::Set(char32_t code, TileInfo* tile)
+	{
+		if (!tile)
+		{
+			Erase(code);
+			return;
+		}
+
+		Directory& directory = m_directories[code >> 24];
+		size_t page_index = GetPageIndex(code);
+		if (page_index >= directory.size())
+			directory.resize(page_index + 1);
+
+		std::unique_ptr<Page>& page = directory[page_index];
+		if (!page)
+			page.reset(new Page());
+
+		TileInfo*& slot = page->tiles[code & kPageMask];
+		if (!slot)
+		{
+			page->count += 1;
+		}
+		slot = tile;
+	}
+
+	void Codespace::Erase(char32_t code)
+	{
+		Directory& directory = m_directories[code >> 24];
+		size_t page_index = GetPageIndex(code);
+		if (page_index >= directory.size() || !directory[page_index])
+			return;
+
+		std::unique_ptr<Page>& page = directory[page_index];
+		TileInfo*& slot = page->tiles[code & kPageMask];
+		if (slot)
+		{
+			slot = nullptr;
+			page->count -= 1;
+		}
+
+		if (page->count == 0)
+			page.reset();
+	}
+
+	void Codespace::Clear()
+	{
+		for (auto& directory: m_directories)
+			directory.clear();
+	}
+}
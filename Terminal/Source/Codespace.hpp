@@ -0,0 +1,115 @@
+/*
+* BearLibTerminal
+* Copyright (C) 2013-2017 Cfyz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+* of the Software, and to permit persons to whom the Software is furnished to do
+* so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+* COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+* IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BEARLIBTERMINAL_CODESPACE_HPP
+#define BEARLIBTERMINAL_CODESPACE_HPP
+
+#include "Atlas.hpp"
+#include <array>
+#include <vector>
+#include <memory>
+
+namespace BearLibTerminal
+{
+	// Maps character codes to prepared tiles. This is looked up for every leaf on every
+	// frame, so instead of hashing it uses a paged direct-indexed table: codes are split
+	// into a font index (highest byte), a page index and a slot within a 256-code page.
+	// Pages are allocated on demand. Tiles are not owned by the codespace, they belong to
+	// their respective tilesets.
+	class Codespace
+	{
+	public:
+		Codespace();
+		TileInfo* Get(char32_t code) const;
+		void Set(char32_t code, TileInfo* tile);
+		void Erase(char32_t code);
+		void Clear();
+
+		// Calls predicate(code, tile) for every mapped code and unmaps codes it returns true for.
+		template<typename Predicate> void EraseIf(Predicate predicate);
+
+		static const int kPageBits = 8;
+		static const char32_t kPageSize = 1 << kPageBits;
+		static const char32_t kPageMask = kPageSize - 1;
+
+	private:
+		struct Page
+		{
+			Page();
+			std::array<TileInfo*, kPageSize> tiles;
+			int count;
+		};
+
+		typedef std::vector<std::unique_ptr<Page>> Directory;
+
+		static size_t GetPageIndex(char32_t code);
+		std::array<Directory, 256> m_directories;
+	};
+
+	inline size_t Codespace::GetPageIndex(char32_t code)
+	{
+		return (code & 0x00FFFFFF) >> kPageBits;
+	}
+
+	inline TileInfo* Codespace::Get(char32_t code) const
+	{
+		const Directory& directory = m_directories[code >> 24];
+		size_t page_index = GetPageIndex(code);
+		if (page_index >= directory.size())
+			return nullptr;
+
+		const Page* page = directory[page_index].get();
+		return page? page->tiles[code & kPageMask]: nullptr;
+	}
+
+	template<typename Predicate> void Codespace::EraseIf(Predicate predicate)
+	{
+		for (size_t font = 0; font < m_directories.size(); font++)
+		{
+			Directory& directory = m_directories[font];
+			for (size_t page_index = 0; page_index < directory.size(); page_index++)
+			{
+				Page* page = directory[page_index].get();
+				if (!page)
+					continue;
+
+				char32_t base = (char32_t)((font << 24) | (page_index << kPageBits));
+				for (char32_t slot = 0; slot < kPageSize && page->count > 0; slot++)
+				{
+					TileInfo* tile = page->tiles[slot];
+					if (tile && predicate(base + slot, tile))
+					{
+						page->tiles[slot] = nullptr;
+						page->count -= 1;
+					}
+				}
+
+				if (page->count == 0)
+					directory[page_index].reset();
+			}
+		}
+	}
+
+	extern Codespace g_codespace;
+}
+
+#endif // BEARLIBTERMINAL_CODESPACE_HPP
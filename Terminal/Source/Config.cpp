@@ -92,6 +92,7 @@ namespace BearLibTerminal
 	{
 		// Clear previous state.
 		m_sections.clear();
+		m_lookups.clear();
 		m_filename.clear();
 
 		m_filename = GuessConfigFilename();
@@ -197,7 +198,32 @@ namespace BearLibTerminal
 		}
 	}
 
-	bool Config::TryGet(std::wstring name, std::wstring& out)
+	bool Config::TryGet(const std::wstring& name, std::wstring& out)
+	{
+		if (name == L"clipboard")
+		{
+			out = GetClipboardContents();
+			return true;
+		}
+
+		// Print substitutes config values by name, so the same few names (and some
+		// that are not config values at all) are looked up over and over.
+		auto i = m_lookups.find(name);
+		if (i == m_lookups.end())
+		{
+			if (m_lookups.size() >= kMaxCachedLookups)
+				m_lookups.clear();
+			CachedLookup lookup;
+			lookup.found = Find(name, lookup.value);
+			i = m_lookups.emplace(name, std::move(lookup)).first;
+		}
+
+		if (i->second.found)
+			out = i->second.value;
+		return i->second.found;
+	}
+
+	bool Config::Find(std::wstring name, std::wstring& out)
 	{
 		if (name.empty())
 		{
@@ -208,11 +234,6 @@ namespace BearLibTerminal
 			out = UTF8Encoding().Convert(TERMINAL_VERSION);
 			return true;
 		}
-		else if (name == L"clipboard")
-		{
-			out = GetClipboardContents();
-			return true;
-		}
 		else if (!starts_with<wchar_t>(name, L"sys.") && !starts_with<wchar_t>(name, L"ini."))
 		{
 			name = L"sys." + name;
@@ -303,6 +324,9 @@ namespace BearLibTerminal
 			return;
 		}
 
+		// Cached lookups may have found the old value or none at all.
+		m_lookups.clear();
+
 		// Keep it in memory in any case.
 		Section& section = m_sections[name.substr(0, domain_name_length)+section_name];
 		Property& property = section.m_properties[property_name];
@@ -24,6 +24,7 @@
 #define BEARLIBTERMINAL_CONFIGURATION_HPP
 
 #include <map>
+#include <unordered_map>
 #include <string>
 #include <algorithm>
 #include <ctype.h>
@@ -58,10 +59,11 @@ namespace BearLibTerminal
 	{
 	public:
 		void Reload();
-		bool TryGet(std::wstring name, std::wstring& out);
+		bool TryGet(const std::wstring& name, std::wstring& out);
 		std::map<std::wstring, std::wstring> List(const std::wstring& section);
 		void Set(std::wstring name, std::wstring value);
 		static Config& Instance();
+		static const size_t kMaxCachedLookups = 1024;
 
 		template<typename T> bool TryGet(std::wstring name, T& out)
 		{
@@ -75,6 +77,7 @@ namespace BearLibTerminal
 		Config();
 		std::wstring GuessConfigFilename();
 		void Update(std::wstring section, std::wstring property, std::wstring value);
+		bool Find(std::wstring name, std::wstring& out);
 
 		struct Property
 		{
@@ -86,8 +89,16 @@ namespace BearLibTerminal
 			std::map<std::wstring, Property, ci_less<wchar_t>> m_properties;
 		};
 
+		struct CachedLookup
+		{
+			bool found;
+			std::wstring value;
+		};
+
 		std::wstring m_filename;
 		std::map<std::wstring, Section, ci_less<wchar_t>> m_sections;
+		std::unordered_map<std::wstring, CachedLookup> m_lookups; // Results of TryGet by name, both found and not
+
 	};
 }
 
@@ -26,6 +26,9 @@
 #include "Utility.hpp"
 #include "Geometry.hpp"
 #include "Encoding.hpp"
+#include <algorithm>
+#include <future>
+#include <thread>
 #include <cmath>
 
 namespace BearLibTerminal
@@ -494,33 +497,46 @@ namespace BearLibTerminal
 		return (code >= 0x2500 && code <= 0x259F) || code == kUnicodeReplacementCharacter;
 	}
 
-	Bitmap GenerateDynamicTile(char32_t code, Size size)
+	DynamicTileShape DescribeDynamicTile(char32_t code)
 	{
 		code = (code & Tileset::kCharOffsetMask);
 
+		DynamicTileShape shape;
+		shape.kind = DynamicTileShape::NotACharacter;
+
+		auto dashes = [&shape](bool vertical, bool thick, int parts)
+		{
+			shape.kind = DynamicTileShape::DashLines;
+			shape.vertical = vertical;
+			shape.thick = thick;
+			shape.parts = parts;
+		};
+
+		auto shade = [&shape](int alpha)
+		{
+			shape.kind = DynamicTileShape::Shade;
+			shape.alpha = alpha;
+		};
+
 		if ((code >= 0x2500 && code <= 0x2503) ||
 			(code >= 0x250C && code <= 0x254B) ||
 			(code >= 0x2550 && code <= 0x256C) ||
 			(code >= 0x2574 && code <= 0x257F))
 		{
-			int i = code - 0x2500;
-			std::vector<int> tmp;
-			for (int j=0; j<25; j++)
-				tmp.push_back(box_lines[i][j]);
-			return MakeBoxLines(size, tmp);
+			shape.kind = DynamicTileShape::BoxLines;
+			shape.pattern = box_lines[code - 0x2500];
 		}
 		else if ((code >= 0x2580 && code <= 0x2590) || (code >= 0x2594 && code <= 0x2595))
 		{
 			int i = code - 0x2580;
-			if (splits[i][0] > 0)
-				return MakeHorisontalSplit(size, splits[i][1], splits[i][2]);
-			else
-				return MakeVerticalSplit(size, splits[i][1], splits[i][2]);
+			shape.kind = splits[i][0] > 0? DynamicTileShape::HorisontalSplit: DynamicTileShape::VerticalSplit;
+			shape.from = splits[i][1];
+			shape.to = splits[i][2];
 		}
 		else if (code >= 0x2596 && code <= 0x259F)
 		{
-			int i = code - 0x2596;
-			return MakeQuadrandTile(size, quadrants[i][0], quadrants[i][1], quadrants[i][2], quadrants[i][3]);
+			shape.kind = DynamicTileShape::Quadrants;
+			shape.quadrants = quadrants[code - 0x2596];
 		}
 		else
 		{
@@ -529,42 +545,42 @@ namespace BearLibTerminal
 			// U+2500..U+2503: Light and heavy solid lines
 			// U+2504..U+250B: Light and heavy dashed lines
 			case 0x2504:
-				return MakeDashLines(size, false, false, 3); // Single triple horisontal dash
+				dashes(false, false, 3); // Single triple horisontal dash
 				break;
 			case 0x2505:
-				return MakeDashLines(size, false, true, 3); // Wide triple horisontal dash
+				dashes(false, true, 3); // Wide triple horisontal dash
 				break;
 			case 0x2506:
-				return MakeDashLines(size, true, false, 3); // Single triple vertical dash
+				dashes(true, false, 3); // Single triple vertical dash
 				break;
 			case 0x2507:
-				return MakeDashLines(size, true, true, 3); // Wide triple horisontal dash
+				dashes(true, true, 3); // Wide triple horisontal dash
 				break;
 			case 0x2508:
-				return MakeDashLines(size, false, false, 4); // Singlee quadruple horisontal dash
+				dashes(false, false, 4); // Singlee quadruple horisontal dash
 				break;
 			case 0x2509:
-				return MakeDashLines(size, false, true, 4); // Wide quadruple horisontal dash
+				dashes(false, true, 4); // Wide quadruple horisontal dash
 				break;
 			case 0x250A:
-				return MakeDashLines(size, true, false, 4); // Single quadruple vertical dash
+				dashes(true, false, 4); // Single quadruple vertical dash
 				break;
 			case 0x250B:
-				return MakeDashLines(size, true, true, 4); // Wide quadruple vertical dash
+				dashes(true, true, 4); // Wide quadruple vertical dash
 				break;
 			// U+250C..U+254B: Light and heavy line box components
 			// U+254C..U+254F: Light and heavy dashed lines
 			case 0x254C:
-				return MakeDashLines(size, false, false, 2); // BOX DRAWINGS LIGHT DOUBLE DASH HORIZONTAL
+				dashes(false, false, 2); // BOX DRAWINGS LIGHT DOUBLE DASH HORIZONTAL
 				break;
 			case 0x254D:
-				return MakeDashLines(size, false, true, 2); // BOX DRAWINGS HEAVY DOUBLE DASH HORIZONTAL
+				dashes(false, true, 2); // BOX DRAWINGS HEAVY DOUBLE DASH HORIZONTAL
 				break;
 			case 0x254E:
-				return MakeDashLines(size, true, false, 2); // BOX DRAWINGS LIGHT DOUBLE DASH VERTICAL
+				dashes(true, false, 2); // BOX DRAWINGS LIGHT DOUBLE DASH VERTICAL
 				break;
 			case 0x254F:
-				return MakeDashLines(size, true, true, 2); // BOX DRAWINGS HEAVY DOUBLE DASH VERTICAL
+				dashes(true, true, 2); // BOX DRAWINGS HEAVY DOUBLE DASH VERTICAL
 				break;
 			// U+2550..U+2551: Double lines
 			// U+2552..U+256C: Light and double line box components
@@ -573,53 +589,141 @@ namespace BearLibTerminal
 			// U+2580..U+2590: Block elements 1
 			// U+2591..U+2593: Shade characters
 			case 0x2591:
-				return Bitmap(size, Color(64, 255, 255, 255)); // ░ LIGHT SHADE
+				shade(64); // ░ LIGHT SHADE
 				break;
 			case 0x2592:
-				return Bitmap(size, Color(128, 255, 255, 255)); // ▒ MEDIUM SHADE
+				shade(128); // ▒ MEDIUM SHADE
 				break;
 			case 0x2593:
-				return Bitmap(size, Color(192, 255, 255, 255)); // ▓ DARK SHADE
+				shade(192); // ▓ DARK SHADE
 				break;
 			// U+2594..U+2595: Block elements 2
 			// U+2596..U+259F: Block elements 3 (quadrants)
 			default:
-				return MakeNotACharacterTile(size);
 				break;
 			}
 		}
 
-		return MakeNotACharacterTile(size);
+		return shape;
 	}
 
-	std::shared_ptr<TileInfo> DynamicTileset::Get(char32_t code)
+	Bitmap RasterizeDynamicTile(const DynamicTileShape& shape, Size size)
 	{
-		if (!Provides(code))
+		switch (shape.kind)
 		{
-			throw std::runtime_error("DynamicTileset::Prepare: request for a tile which is not provided by this tileset");
+		case DynamicTileShape::BoxLines:
+			return MakeBoxLines(size, std::vector<int>(shape.pattern, shape.pattern + 25));
+		case DynamicTileShape::DashLines:
+			return MakeDashLines(size, shape.vertical, shape.thick, shape.parts);
+		case DynamicTileShape::VerticalSplit:
+			return MakeVerticalSplit(size, shape.from, shape.to);
+		case DynamicTileShape::HorisontalSplit:
+			return MakeHorisontalSplit(size, shape.from, shape.to);
+		case DynamicTileShape::Quadrants:
+			return MakeQuadrandTile(size, shape.quadrants[0], shape.quadrants[1], shape.quadrants[2], shape.quadrants[3]);
+		case DynamicTileShape::Shade:
+			return Bitmap(size, Color(shape.alpha, 255, 255, 255));
+		default:
+			return MakeNotACharacterTile(size);
 		}
+	}
 
-		auto i = m_cache.find(code);
-		if (i != m_cache.end())
-		{
-			return i->second;
-		}
+	Bitmap GenerateDynamicTile(char32_t code, Size size)
+	{
+		return RasterizeDynamicTile(DescribeDynamicTile(code), size);
+	}
 
+	Size DynamicTileset::GetSpacing(char32_t code)
+	{
 		Size spacing{1, 1};
 		char32_t font_offset = (code & Tileset::kFontOffsetMask);
-		auto j = g_tilesets.find(font_offset);\
+		auto j = g_tilesets.find(font_offset);
 		if (j != g_tilesets.end())
 		{
 			spacing = j->second->GetSpacing();
 		}
+		return spacing;
+	}
 
-		Bitmap tile = GenerateDynamicTile(code, m_tile_size * spacing);
-
+	std::shared_ptr<TileInfo> DynamicTileset::MakeTile(Size spacing, Bitmap bitmap)
+	{
 		auto tile_ref = std::make_shared<TileInfo>();
 		tile_ref->tileset = this;
 		tile_ref->alignment = TileAlignment::TopLeft;
 		tile_ref->spacing = spacing;
-		tile_ref->bitmap = tile;
+		tile_ref->bitmap = std::move(bitmap);
+		return tile_ref;
+	}
+
+	void DynamicTileset::Prepare(const std::vector<char32_t>& codes)
+	{
+		struct Job
+		{
+			char32_t code;
+			Size spacing;
+			DynamicTileShape shape;
+			Bitmap bitmap;
+		};
+
+		// Only the tiles missing from the cache (or made for another spacing) need rasterizing.
+		std::vector<Job> jobs;
+		for (char32_t code: codes)
+		{
+			if (!Provides(code))
+				continue;
+
+			Size spacing = GetSpacing(code);
+			auto i = m_cache.find(code);
+			if (i != m_cache.end() && i->second->spacing == spacing)
+				continue;
+
+			jobs.push_back(Job{code, spacing, DescribeDynamicTile(code), Bitmap{}});
+		}
+
+		if (jobs.empty())
+			return;
+
+		// Shapes are plain data, so the bitmaps can be rasterized independently.
+		size_t workers = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+		size_t chunk = (jobs.size() + workers - 1) / workers;
+		std::vector<std::future<void>> tasks;
+		for (size_t begin = 0; begin < jobs.size(); begin += chunk)
+		{
+			size_t end = std::min(begin + chunk, jobs.size());
+			tasks.push_back(std::async(std::launch::async, [this, &jobs, begin, end]
+			{
+				for (size_t i = begin; i < end; i++)
+					jobs[i].bitmap = RasterizeDynamicTile(jobs[i].shape, m_tile_size * jobs[i].spacing);
+			}));
+		}
+
+		for (auto& task: tasks)
+			task.get();
+
+		LOG(Debug, L"DynamicTileset: generated " << jobs.size() << L" tile(s) of size " << m_tile_size);
+
+		for (auto& job: jobs)
+			m_cache[job.code] = MakeTile(job.spacing, std::move(job.bitmap));
+	}
+
+	std::shared_ptr<TileInfo> DynamicTileset::Get(char32_t code)
+	{
+		if (!Provides(code))
+		{
+			throw std::runtime_error("DynamicTileset::Prepare: request for a tile which is not provided by this tileset");
+		}
+
+		Size spacing = GetSpacing(code);
+
+		// A tile cached for a different spacing is never in the codespace at this
+		// point, so it is safe to replace.
+		auto i = m_cache.find(code);
+		if (i != m_cache.end() && i->second->spacing == spacing)
+		{
+			return i->second;
+		}
+
+		auto tile_ref = MakeTile(spacing, GenerateDynamicTile(code, m_tile_size * spacing));
 		m_cache[code] = tile_ref;
 		return tile_ref;
 	}
@@ -27,6 +27,25 @@
 
 namespace BearLibTerminal
 {
+	// Resolution-independent description of a dynamic tile. Rasterizing it
+	// for a particular tile size is a pure function of the shape and the size.
+	struct DynamicTileShape
+	{
+		enum Kind {NotACharacter, BoxLines, DashLines, VerticalSplit, HorisontalSplit, Quadrants, Shade};
+
+		Kind kind;
+		const char* pattern;   // BoxLines: 5x5 line map
+		bool vertical, thick;  // DashLines
+		int parts;             // DashLines
+		float from, to;        // VerticalSplit, HorisontalSplit
+		const bool* quadrants; // Quadrants: top-left, top-right, bottom-left, bottom-right
+		int alpha;             // Shade
+	};
+
+	DynamicTileShape DescribeDynamicTile(char32_t code);
+
+	Bitmap RasterizeDynamicTile(const DynamicTileShape& shape, Size size);
+
 	class DynamicTileset: public Tileset
 	{
 	public:
@@ -35,7 +54,10 @@ namespace BearLibTerminal
 		Size GetBoundingBoxSize();
 		bool Provides(char32_t code);
 		std::shared_ptr<TileInfo> Get(char32_t code);
+		void Prepare(const std::vector<char32_t>& codes);
 	private:
+		Size GetSpacing(char32_t code);
+		std::shared_ptr<TileInfo> MakeTile(Size spacing, Bitmap bitmap);
 		Size m_tile_size;
 	};
 }
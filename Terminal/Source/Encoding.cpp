@@ -28,6 +28,7 @@
 #include "OptionGroup.hpp"
 #include <unordered_map>
 #include <stdint.h>
+#include <string.h>
 #include <istream>
 //#include <iostream>
 #include <fstream>
@@ -252,15 +253,41 @@ namespace BearLibTerminal
 	std::wstring UTF8Encoding::Convert(const std::string& value) const
 	{
 		std::wstring result;
+		Decode(value.data(), value.length(), result);
+		return result;
+	}
+
+	template<> void Decode<char>(const char* value, size_t length, std::wstring& out)
+	{
+		// There can't be more characters than bytes, the excess is trimmed afterwards.
+		size_t start = out.size();
+		out.resize(start + length);
+		wchar_t* result = &out[0] + start;
 
 		size_t index = 0;
-		while (index < value.length())
+		while (index < length)
 		{
+			// Most of the text is usually ASCII: check eight bytes at once and
+			// widen them as is if none of them has the high bit set.
+			while (index + 8 <= length)
+			{
+				uint64_t block;
+				memcpy(&block, value + index, 8);
+				if (block & 0x8080808080808080ULL)
+					break;
+				for (int i = 0; i < 8; i++)
+					*result++ = (wchar_t)value[index+i];
+				index += 8;
+			}
+
+			if (index >= length)
+				break;
+
 			size_t extraBytesToRead = kTrailingBytesForUTF8[(uint8_t)value[index]];
-			if (index+extraBytesToRead >= value.length())
+			if (index+extraBytesToRead >= length)
 			{
 				// Stop here
-				return result;
+				break;
 			}
 
 			// TODO: Do UTF-8 check
@@ -278,20 +305,20 @@ namespace BearLibTerminal
 				// Target is a character <= 0xFFFF
 				if (ch >= kSurrogateHighStart && ch <= kSurrogateHighEnd)
 				{
-					result.push_back(kReplacementChar);
+					*result++ = kReplacementChar;
 				}
 				else
 				{
-					result.push_back((wchar_t)ch); // Normal case
+					*result++ = (wchar_t)ch; // Normal case
 				}
 			}
 			else // Above 0xFFFF
 			{
-				result.push_back(kReplacementChar);
+				*result++ = kReplacementChar;
 			}
 		}
 
-		return result;
+		out.resize(result - out.data());
 	}
 
 	std::string UTF8Encoding::Convert(const std::wstring& value) const
@@ -339,12 +366,17 @@ namespace BearLibTerminal
 
 	std::wstring UCS2Encoding::Convert(const std::u16string& value) const
 	{
-#if __SIZEOF_WCHAR_T__ == 2
-		return std::wstring((const wchar_t*)value.data(), value.size());
-#else
 		std::wstring result;
-		for (auto c: value) result += (wchar_t)c;
+		Decode(value.data(), value.size(), result);
 		return result;
+	}
+
+	template<> void Decode<char16_t>(const char16_t* value, size_t length, std::wstring& out)
+	{
+#if __SIZEOF_WCHAR_T__ == 2
+		out.append((const wchar_t*)value, length);
+#else
+		out.append(value, value + length);
 #endif
 	}
 
@@ -378,15 +410,25 @@ namespace BearLibTerminal
 
 	std::wstring UCS4Encoding::Convert(const std::u32string& value) const
 	{
-#if __SIZEOF_WCHAR_T__ == 4
-		return std::wstring((const wchar_t*)value.data(), value.size());
-#else
 		std::wstring result;
-		for (auto c: value) result += (wchar_t)c;
+		Decode(value.data(), value.size(), result);
 		return result;
+	}
+
+	template<> void Decode<char32_t>(const char32_t* value, size_t length, std::wstring& out)
+	{
+#if __SIZEOF_WCHAR_T__ == 4
+		out.append((const wchar_t*)value, length);
+#else
+		out.append(value, value + length);
 #endif
 	}
 
+	template<> void Decode<wchar_t>(const wchar_t* value, size_t length, std::wstring& out)
+	{
+		out.append(value, length);
+	}
+
 	std::u32string UCS4Encoding::Convert(const std::wstring& value) const
 	{
 #if __SIZEOF_WCHAR_T__ == 4
@@ -47,6 +47,14 @@ namespace BearLibTerminal
 
 	std::unique_ptr<Encoding8> GetUnibyteEncoding(const std::wstring& name);
 
+	// Appends a decoded string to the output without any temporary strings. The result
+	// is the same as Convert() of the respective encoding from Encodings<CharT> gives.
+	template<typename CharT> void Decode(const CharT* value, size_t length, std::wstring& out);
+	template<> void Decode<char>(const char* value, size_t length, std::wstring& out);
+	template<> void Decode<char16_t>(const char16_t* value, size_t length, std::wstring& out);
+	template<> void Decode<char32_t>(const char32_t* value, size_t length, std::wstring& out);
+	template<> void Decode<wchar_t>(const wchar_t* value, size_t length, std::wstring& out);
+
 	struct UTF8Encoding: Encoding8
 	{
 		wchar_t Convert(int value) const;
@@ -76,16 +76,28 @@ namespace BearLibTerminal
 	void Log::Reset()
 	{
 		GetEnvironmentVariable(L"BEARLIB_LOGFILE", filename);
-		try_parse(GetEnvironmentVariable(L"BEARLIB_LOGLEVEL"), level);
+		Level value = level;
+		try_parse(GetEnvironmentVariable(L"BEARLIB_LOGLEVEL"), value);
+		level = value;
 		try_parse(GetEnvironmentVariable(L"BEARLIB_LOGMODE"), mode);
 		m_truncated = false;
 	}
 
+	void Log::Configure(const std::wstring& filename, Level level, Mode mode)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		this->filename = filename;
+		this->level = level;
+		this->mode = mode;
+	}
+
 	void Log::Write(Level level, const std::wstring& what)
 	{
 		std::wostringstream ss;
 		ss << FormatTime().c_str() << " [" << level << "] " << what << std::endl;
 
+		std::lock_guard<std::mutex> guard(m_lock);
+
 		if (filename.empty() || level <= Level::Error)
 		{
 			WriteStandardError(UTF8Encoding().Convert(ss.str()).c_str());
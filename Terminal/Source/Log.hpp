@@ -25,6 +25,8 @@
 
 #include <string>
 #include <sstream>
+#include <mutex>
+#include <atomic>
 
 namespace BearLibTerminal
 {
@@ -37,14 +39,16 @@ namespace BearLibTerminal
 	public:
 		void Write(Level level, const std::wstring& what);
 		void Reset();
+		void Configure(const std::wstring& filename, Level level, Mode mode); // While tilesets may be loading
 		static Log& Instance();
 		std::wstring filename;
-		Level level;
+		std::atomic<Level> level; // Checked by LOG on any thread
 		Mode mode;
 
 	private:
 		Log();
 		bool m_truncated;
+		std::mutex m_lock; // Tilesets may be loaded (and log) on worker threads
 	};
 
 	std::wostream& operator<< (std::wostream& stream, Log::Level value);
@@ -76,6 +76,7 @@ typedef lua_Number (*PFNLUATONUMBERX)(lua_State *L, int index, int* isnum); // l
 typedef lua_Integer (*PFNLUATOINTEGER)(lua_State *L, int idx); // lua_tointeger
 typedef lua_Integer (*PFNLUATOINTEGERX)(lua_State *L, int idx, int* isnum); // lua_tointegerx
 typedef void (*PFNLUARAWGETI)(lua_State *L, int idx, int n); // lua_rawgeti
+typedef void (*PFNLUARAWSETI)(lua_State *L, int idx, int n); // lua_rawseti
 typedef int (*PFNLUATYPE)(lua_State *L, int idx); // lua_type
 typedef void (*PFNLUAPUSHBOOLEAN)(lua_State *L, int b); // lua_pushboolean
 typedef void (*PFNLUAGETTABLE)(lua_State *L, int idx); // lua_gettable
@@ -106,6 +107,7 @@ static PFNLUATONUMBERX lua_tonumberx = 0;
 static PFNLUATOINTEGER lua_tointeger = 0;
 static PFNLUATOINTEGERX lua_tointegerx = 0;
 static PFNLUARAWGETI lua_rawgeti = 0;
+static PFNLUARAWSETI lua_rawseti = 0;
 static PFNLUATYPE lua_type = 0;
 static PFNLUAPUSHBOOLEAN lua_pushboolean = 0;
 static PFNLUAGETTABLE lua_gettable = 0;
@@ -284,6 +286,54 @@ int luaterminal_clear_area(lua_State* L)
 	return 0;
 }
 
+int luaterminal_scroll(lua_State* L)
+{
+	int x = lua_tointeger(L, 1);
+	int y = lua_tointeger(L, 2);
+	int w = lua_tointeger(L, 3);
+	int h = lua_tointeger(L, 4);
+	int dx = lua_tointeger(L, 5);
+	int dy = lua_tointeger(L, 6);
+	terminal_scroll(x, y, w, h, dx, dy);
+	return 0;
+}
+
+int luaterminal_layer_offset(lua_State* L)
+{
+	terminal_layer_offset(lua_tointeger(L, 1), lua_tointeger(L, 2));
+	return 0;
+}
+
+int luaterminal_layer_size(lua_State* L)
+{
+	terminal_layer_size(lua_tointeger(L, 1), lua_tointeger(L, 2));
+	return 0;
+}
+
+int luaterminal_layer_origin(lua_State* L)
+{
+	terminal_layer_origin(lua_tointeger(L, 1), lua_tointeger(L, 2));
+	return 0;
+}
+
+int luaterminal_snapshot_layer(lua_State* L)
+{
+	lua_pushnumber(L, terminal_snapshot_layer(lua_tointeger(L, 1)));
+	return 1;
+}
+
+int luaterminal_restore_layer(lua_State* L)
+{
+	terminal_restore_layer(lua_tointeger(L, 1));
+	return 0;
+}
+
+int luaterminal_release_snapshot(lua_State* L)
+{
+	terminal_release_snapshot(lua_tointeger(L, 1));
+	return 0;
+}
+
 int luaterminal_crop(lua_State* L)
 {
 	int x = lua_tointeger(L, 1);
@@ -401,6 +451,99 @@ int luaterminal_put_ext(lua_State* L)
 	return 0;
 }
 
+int luaterminal_put_array(lua_State* L)
+{
+	// Stack: x, y, w, h, {codes}[, {fg}[, {bg}]]
+	if (!check_stack(L, {LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER, LUA_TTABLE}))
+	{
+		lua_pushstring(L, "luaterminal_put_array: invalid number or types of arguments");
+		lua_error(L);
+		return 0;
+	}
+
+	int w = lua_tointeger(L, 3);
+	int h = lua_tointeger(L, 4);
+	if (w <= 0 || h <= 0)
+		return 0;
+
+	static std::vector<int> codes;
+	static std::vector<color_t> fg, bg;
+
+	auto read = [L](int index, std::vector<color_t>& out) -> color_t*
+	{
+		if (lua_type(L, index) != LUA_TTABLE)
+			return nullptr;
+		out.resize(lua_objlen(L, index));
+		for (size_t i = 0; i < out.size(); i++)
+		{
+			lua_rawgeti(L, index, i+1);
+			out[i] = (color_t)lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+		return out.data();
+	};
+
+	codes.resize(lua_objlen(L, 5));
+	for (size_t i = 0; i < codes.size(); i++)
+	{
+		lua_rawgeti(L, 5, i+1);
+		codes[i] = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+	}
+	color_t* fg_data = read(6, fg);
+	color_t* bg_data = read(7, bg);
+
+	size_t area = (size_t)w * h;
+	if (codes.size() < area || (fg_data && fg.size() < area) || (bg_data && bg.size() < area))
+	{
+		lua_pushstring(L, "luaterminal_put_array: tables are smaller than the rectangle");
+		lua_error(L);
+		return 0;
+	}
+
+	terminal_put_array(lua_tointeger(L, 1), lua_tointeger(L, 2), w, h, codes.data(), fg_data, bg_data, 0);
+	return 0;
+}
+
+static color_t to_color(lua_State* L, int index)
+{
+	int type = lua_type(L, index);
+	if (type == LUA_TNUMBER)
+		return (color_t)lua_tonumber(L, index);
+	else if (type == LUA_TSTRING)
+		return color_from_name8((const int8_t*)lua_tostring(L, index));
+	else
+		return 0;
+}
+
+int luaterminal_fill(lua_State* L)
+{
+	// Stack: x, y, w, h, code, fg[, bg]
+	if (!check_stack(L, {LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER}))
+	{
+		lua_pushstring(L, "luaterminal_fill: invalid number or types of arguments");
+		lua_error(L);
+		return 0;
+	}
+
+	terminal_fill(lua_tointeger(L, 1), lua_tointeger(L, 2), lua_tointeger(L, 3), lua_tointeger(L, 4), lua_tointeger(L, 5), to_color(L, 6), to_color(L, 7));
+	return 0;
+}
+
+int luaterminal_fill_bkcolor(lua_State* L)
+{
+	// Stack: x, y, w, h, bg
+	if (!check_stack(L, {LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER, LUA_TNUMBER}))
+	{
+		lua_pushstring(L, "luaterminal_fill_bkcolor: invalid number or types of arguments");
+		lua_error(L);
+		return 0;
+	}
+
+	terminal_fill_bkcolor(lua_tointeger(L, 1), lua_tointeger(L, 2), lua_tointeger(L, 3), lua_tointeger(L, 4), to_color(L, 5));
+	return 0;
+}
+
 int luaterminal_pick(lua_State* L)
 {
 	int nargs = lua_gettop(L);
@@ -490,6 +633,71 @@ int luaterminal_printf(lua_State* L)
 	return 1;
 }
 
+int luaterminal_print_batch(lua_State* L)
+{
+	// Stack: [{{x, y, s} or {x, y, w, h, align, s}, ...}]
+	// Returns: {{w, h}, ...}
+	if (!check_stack(L, {LUA_TTABLE}))
+	{
+		lua_pushstring(L, "luaterminal_print_batch: invalid number or types of arguments");
+		lua_error(L);
+		return 0;
+	}
+
+	// Strings are kept alive by the argument table while the batch is printed,
+	// which is why they have to be strings and not numbers converted on the stack.
+	static std::vector<print_record_t> records;
+	records.clear();
+
+	size_t count = lua_objlen(L, 1);
+	for (size_t i = 0; i < count; i++)
+	{
+		lua_rawgeti(L, 1, i+1);
+		int record = lua_gettop(L); // Whatever else was passed is below it
+		size_t size = (lua_type(L, record) == LUA_TTABLE)? lua_objlen(L, record): 0;
+		if (size != 3 && size != 6)
+		{
+			lua_pushstring(L, "luaterminal_print_batch: invalid record");
+			lua_error(L);
+			return 0;
+		}
+
+		int values[5] = {0, 0, 0, 0, TK_ALIGN_DEFAULT};
+		for (int j = 0; j < 5; j++)
+		{
+			if (size == 3 && j == 2)
+				break;
+			lua_rawgeti(L, record, j+1);
+			values[j] = lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
+
+		lua_rawgeti(L, record, size);
+		if (lua_type(L, -1) != LUA_TSTRING)
+		{
+			lua_pushstring(L, "luaterminal_print_batch: invalid record");
+			lua_error(L);
+			return 0;
+		}
+		records.push_back(print_record_t{values[0], values[1], values[2], values[3], values[4], lua_tostring(L, -1), dimensions_t{0, 0}});
+		lua_pop(L, 2);
+	}
+
+	terminal_print_batch8(records.data(), records.size());
+
+	lua_createtable(L, records.size(), 0);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		lua_createtable(L, 2, 0);
+		lua_pushnumber(L, records[i].size.width);
+		lua_rawseti(L, -2, 1);
+		lua_pushnumber(L, records[i].size.height);
+		lua_rawseti(L, -2, 2);
+		lua_rawseti(L, -2, i+1);
+	}
+	return 1;
+}
+
 int luaterminal_measure(lua_State* L)
 {
 	int w = 0, h = 0, pattern_index;
@@ -643,7 +851,14 @@ static const luaL_Reg luaterminal_lib[] =
 	{"refresh", luaterminal_refresh},
 	{"clear", luaterminal_clear},
 	{"clear_area", luaterminal_clear_area},
+	{"scroll", luaterminal_scroll},
 	{"crop", luaterminal_crop},
+	{"layer_offset", luaterminal_layer_offset},
+	{"layer_size", luaterminal_layer_size},
+	{"layer_origin", luaterminal_layer_origin},
+	{"snapshot_layer", luaterminal_snapshot_layer},
+	{"restore_layer", luaterminal_restore_layer},
+	{"release_snapshot", luaterminal_release_snapshot},
 	{"layer", luaterminal_layer},
 	{"color", luaterminal_color},
 	{"bkcolor", luaterminal_bkcolor},
@@ -651,11 +866,15 @@ static const luaL_Reg luaterminal_lib[] =
 	{"font", luaterminal_font},
 	{"put", luaterminal_put},
 	{"put_ext", luaterminal_put_ext},
+	{"put_array", luaterminal_put_array},
+	{"fill", luaterminal_fill},
+	{"fill_bkcolor", luaterminal_fill_bkcolor},
 	{"pick", luaterminal_pick},
 	{"pick_color", luaterminal_pick_color},
 	{"pick_bkcolor", luaterminal_pick_bkcolor},
 	{"print", luaterminal_print},
 	{"printf", luaterminal_printf},
+	{"print_batch", luaterminal_print_batch},
 	{"measure", luaterminal_measure},
 	{"measuref", luaterminal_measuref},
 	{"has_input", luaterminal_has_input},
@@ -802,8 +1021,11 @@ luaterminal_constants[] =
 	CONST(TK_WCHAR),
 	CONST(TK_EVENT),
 	CONST(TK_FULLSCREEN),
+	CONST(TK_TILESET_OFFSET),
+	CONST(TK_TILESET_STATUS),
 	CONST(TK_CLOSE),
 	CONST(TK_RESIZED),
+	CONST(TK_TILESET_LOADED),
 	CONST(TK_OFF),
 	CONST(TK_ON),
 	CONST(TK_INPUT_NONE),
@@ -839,6 +1061,7 @@ int luaopen_BearLibTerminal(lua_State* L)
 	lua_pushinteger = (PFNLUAPUSHINTEGER)liblua["lua_pushinteger"];
 	lua_tolstring = (PFNLUATOSTRING)liblua["lua_tolstring"];
 	lua_rawgeti = (PFNLUARAWGETI)liblua["lua_rawgeti"];
+	lua_rawseti = (PFNLUARAWSETI)liblua["lua_rawseti"];
 	lua_type = (PFNLUATYPE)liblua["lua_type"];
 	lua_pushboolean = (PFNLUAPUSHBOOLEAN)liblua["lua_pushboolean"];
 	lua_gettable = (PFNLUAGETTABLE)liblua["lua_gettable"];
@@ -0,0 +1,453 @@
+/*
+* BearLibTerminal
+* Copyright (C) 2013-2017 Cfyz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+* of the Software, and to permit persons to whom the Software is furnished to do
+* so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+* COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+* IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Markup.hpp"
+#include "Tileset.hpp"
+#include <algorithm>
+#include <string.h>
+
+namespace BearLibTerminal
+{
+	MarkupOp::MarkupOp(Kind kind, uint32_t value):
+		kind(kind),
+		value(value),
+		advance(0)
+	{ }
+
+	CompiledText::CompiledText():
+		cacheable(true),
+		substituted(false)
+	{ }
+
+	namespace
+	{
+		// Simplified classes of Unicode line breaking algorithm (UAX #14).
+		enum class BreakClass
+		{
+			Other,
+			Space,       // Break after, space itself is dropped at the end of a line
+			Hyphen,      // Break after
+			Ideographic, // Break before and after
+			Open,        // Ideographic opening punctuation, no break after
+			Close        // Ideographic closing punctuation, no break before
+		};
+
+		struct BreakClassRange
+		{
+			char32_t first, last;
+			BreakClass value;
+		};
+
+		// Sorted and non-overlapping, everything else is BreakClass::Other.
+		const BreakClassRange kBreakClasses[] =
+		{
+			{0x0020, 0x0020, BreakClass::Space},
+			{0x002D, 0x002D, BreakClass::Hyphen},
+			{0x1100, 0x115F, BreakClass::Ideographic}, // Hangul Jamo initial consonants
+			{0x2010, 0x2010, BreakClass::Hyphen},      // Hyphen
+			{0x2012, 0x2013, BreakClass::Hyphen},      // Figure and en dashes
+			{0x2E80, 0x2FFF, BreakClass::Ideographic}, // CJK and Kangxi radicals
+			{0x3000, 0x3000, BreakClass::Space},       // Ideographic space
+			{0x3001, 0x3002, BreakClass::Close},       // Ideographic comma and full stop
+			{0x3003, 0x3007, BreakClass::Ideographic},
+			{0x3008, 0x3008, BreakClass::Open},        // Angle and corner brackets
+			{0x3009, 0x3009, BreakClass::Close},
+			{0x300A, 0x300A, BreakClass::Open},
+			{0x300B, 0x300B, BreakClass::Close},
+			{0x300C, 0x300C, BreakClass::Open},
+			{0x300D, 0x300D, BreakClass::Close},
+			{0x300E, 0x300E, BreakClass::Open},
+			{0x300F, 0x300F, BreakClass::Close},
+			{0x3010, 0x3010, BreakClass::Open},
+			{0x3011, 0x3011, BreakClass::Close},
+			{0x3012, 0x303F, BreakClass::Ideographic},
+			{0x3040, 0x31FF, BreakClass::Ideographic}, // Kana, Bopomofo
+			{0x3400, 0x4DBF, BreakClass::Ideographic}, // CJK unified ideographs extension A
+			{0x4E00, 0x9FFF, BreakClass::Ideographic}, // CJK unified ideographs
+			{0xA000, 0xA4CF, BreakClass::Ideographic}, // Yi
+			{0xAC00, 0xD7A3, BreakClass::Ideographic}, // Hangul syllables
+			{0xF900, 0xFAFF, BreakClass::Ideographic}, // CJK compatibility ideographs
+			{0xFE30, 0xFE4F, BreakClass::Ideographic}, // CJK compatibility forms
+			{0xFF01, 0xFF01, BreakClass::Close},       // Fullwidth forms
+			{0xFF08, 0xFF08, BreakClass::Open},
+			{0xFF09, 0xFF09, BreakClass::Close},
+			{0xFF0C, 0xFF0C, BreakClass::Close},
+			{0xFF0E, 0xFF0E, BreakClass::Close},
+			{0xFF10, 0xFF19, BreakClass::Ideographic},
+			{0xFF1A, 0xFF1B, BreakClass::Close},
+			{0xFF1F, 0xFF1F, BreakClass::Close},
+			{0xFF21, 0xFF3A, BreakClass::Ideographic},
+			{0xFF41, 0xFF5A, BreakClass::Ideographic},
+			{0xFFE0, 0xFFE6, BreakClass::Ideographic}
+		};
+
+		BreakClass GetBreakClass(char32_t code)
+		{
+			code &= Tileset::kCharOffsetMask;
+			if (code < 0x80)
+				return code == 0x20? BreakClass::Space: code == 0x2D? BreakClass::Hyphen: BreakClass::Other;
+
+			auto end = std::end(kBreakClasses);
+			auto i = std::upper_bound(std::begin(kBreakClasses), end, code,
+				[](char32_t code, const BreakClassRange& range){return code < range.first;});
+			if (i == std::begin(kBreakClasses) || code > (--i)->last)
+				return BreakClass::Other;
+
+			return i->value;
+		}
+
+		// Place where a line may be broken.
+		struct BreakCandidate
+		{
+			size_t end;    // Where the current line would end
+			size_t next;   // Where the next one would start
+			int consumed;  // Width of the symbols before 'next'
+			size_t hyphen; // Break op to make visible, if any
+
+			bool IsValid(size_t line_start) const {return end > line_start;}
+		};
+	}
+
+	void WrapText(CompiledText& text, int width, std::vector<CompiledText::Line>& scratch)
+	{
+		static const size_t kNone = (size_t)-1;
+		auto& ops = text.ops;
+		scratch.clear();
+
+		for (auto line: text.lines)
+		{
+			int length = 0;
+			BreakCandidate none{0, 0, 0, kNone}, last = none, previous = none;
+			BreakClass previous_class = BreakClass::Other;
+			size_t previous_symbol = kNone;
+			bool hanging = false; // Dropping spaces at the line break
+
+			auto add_candidate = [&](size_t end, size_t next, int consumed, size_t hyphen)
+			{
+				previous = last;
+				last = BreakCandidate{end, next, consumed, hyphen};
+			};
+
+			for (size_t j = line.first; j < line.last; j++)
+			{
+				MarkupOp& s = ops[j];
+
+				if (s.kind == MarkupOp::Break)
+				{
+					if (s.value == 0) // Zero width space
+						add_candidate(j, j+1, length, kNone);
+					else if (length + s.spacing.width <= width) // Soft hyphen, if the hyphen fits
+						add_candidate(j+1, j+1, length, j);
+					continue;
+				}
+				else if (s.kind != MarkupOp::Symbol)
+				{
+					continue;
+				}
+
+				BreakClass current_class = GetBreakClass(s.value);
+
+				if (hanging && current_class == BreakClass::Space && length == 0)
+				{
+					s.kind = MarkupOp::Break;
+					s.value = 0;
+					continue;
+				}
+				hanging = false;
+
+				if (current_class == BreakClass::Close && last.IsValid(line.first) && previous_symbol != kNone && last.next > previous_symbol)
+				{
+					// Closing punctuation never starts a line.
+					last = previous;
+					previous = none;
+				}
+				else if (current_class == BreakClass::Ideographic && previous_class != BreakClass::Open && j > line.first)
+				{
+					add_candidate(j, j, length, kNone);
+				}
+
+				if (current_class == BreakClass::Space && length > 0 && length + s.spacing.width > width)
+				{
+					// Spaces hang past the end of a line and are dropped there.
+					scratch.push_back(CompiledText::Line{line.first, j, line.size});
+					line = CompiledText::Line{j+1, line.last, Size(0, 1)};
+					length = 0;
+					last = previous = none;
+					previous_class = current_class;
+					previous_symbol = j;
+					hanging = true;
+					continue;
+				}
+
+				// A symbol at the very beginning of a line stays there no matter how wide it is.
+				while (length > 0 && length + s.spacing.width > width) // cut off
+				{
+					size_t end = j, next = j;
+					int remainder = 0;
+
+					if (last.IsValid(line.first))
+					{
+						end = last.end;
+						next = last.next;
+						remainder = length - last.consumed;
+						if (last.hyphen != kNone)
+							ops[last.hyphen].kind = MarkupOp::Symbol;
+					}
+					// Otherwise there was no line-break opportunities in the line, cut the word in half.
+					// Current symbol makes it overflow so it cannot be left on this line.
+
+					// Combining symbols stay with the symbol they were combined with.
+					size_t skip = next;
+					while (skip < j && ops[skip].kind == MarkupOp::Combine)
+						skip++;
+					if (end == next)
+						end = skip;
+					next = skip;
+
+					scratch.push_back(CompiledText::Line{line.first, end, line.size});
+					line = CompiledText::Line{next, line.last, Size(0, 1)};
+					length = remainder;
+					last = previous = none;
+				}
+
+				length += s.spacing.width;
+
+				if (current_class == BreakClass::Space)
+					add_candidate(j, j+1, length, kNone);
+				else if (current_class == BreakClass::Hyphen || current_class == BreakClass::Ideographic || current_class == BreakClass::Close)
+					add_candidate(j+1, j+1, length, kNone);
+
+				previous_class = current_class;
+				previous_symbol = j;
+			}
+
+			scratch.push_back(line);
+		}
+
+		text.lines.swap(scratch);
+	}
+
+	void PlaceProportionalSymbols(CompiledText& text, int cell_width)
+	{
+		const int cell = cell_width * 64;
+
+		for (auto& line: text.lines)
+		{
+			int pen = 0; // From the line start, in 1/64 of a pixel
+			MarkupOp* last = nullptr; // Of the current run
+
+			auto end_run = [&]
+			{
+				if (last && pen % cell)
+				{
+					last->spacing.width += 1;
+					pen += cell - pen % cell;
+				}
+				last = nullptr;
+			};
+
+			for (size_t j = line.first; j < line.last; j++)
+			{
+				MarkupOp& s = text.ops[j];
+				if (s.kind != MarkupOp::Symbol)
+				{
+					continue;
+				}
+				else if (s.advance == 0)
+				{
+					end_run();
+					pen += s.spacing.width * cell;
+				}
+				else
+				{
+					s.offset = Point((pen % cell) / 64, 0);
+					s.spacing.width = (pen + s.advance) / cell - pen / cell;
+					pen += s.advance;
+					last = &s;
+				}
+			}
+
+			end_run();
+		}
+	}
+
+	MarkupCache::MarkupCache():
+		m_used(0),
+		m_first(-1),
+		m_last(-1),
+		m_substitutions(false)
+	{ }
+
+	int MarkupCache::Find(const MarkupKey& key) const
+	{
+		if (m_buckets.empty())
+			return -1;
+
+		for (int i = m_buckets[key.hash % kBucketCount]; i >= 0; i = m_entries[i].chain)
+		{
+			const Entry& entry = m_entries[i];
+			if (entry.hash == key.hash &&
+				entry.font_offset == key.font_offset &&
+				entry.width == key.width &&
+				entry.raw == key.raw &&
+				entry.unit_size == key.unit_size &&
+				entry.data.size() == key.size &&
+				memcmp(entry.data.data(), key.data, key.size) == 0)
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	void MarkupCache::Release(int index)
+	{
+		Entry& entry = m_entries[index];
+		if (entry.data.capacity() > kMaxTextLength * sizeof(char32_t))
+			std::string().swap(entry.data);
+	}
+
+	void MarkupCache::Link(int index)
+	{
+		Entry& entry = m_entries[index];
+		entry.prev = -1;
+		entry.next = m_first;
+		if (m_first >= 0)
+			m_entries[m_first].prev = index;
+		m_first = index;
+		if (m_last < 0)
+			m_last = index;
+	}
+
+	void MarkupCache::Unlink(int index)
+	{
+		Entry& entry = m_entries[index];
+		if (entry.prev >= 0)
+			m_entries[entry.prev].next = entry.next;
+		else
+			m_first = entry.next;
+		if (entry.next >= 0)
+			m_entries[entry.next].prev = entry.prev;
+		else
+			m_last = entry.prev;
+	}
+
+	void MarkupCache::Unchain(int index)
+	{
+		int* link = &m_buckets[m_entries[index].hash % kBucketCount];
+		while (*link != index)
+			link = &m_entries[*link].chain;
+		*link = m_entries[index].chain;
+	}
+
+	const CompiledText* MarkupCache::Get(const MarkupKey& key, bool measure_only)
+	{
+		int index = Find(key);
+		if (index < 0 || !(m_entries[index].complete || measure_only))
+			return nullptr;
+
+		if (index != m_first)
+		{
+			Unlink(index);
+			Link(index);
+		}
+
+		return &m_entries[index].value;
+	}
+
+	void MarkupCache::Add(const MarkupKey& key, const CompiledText& text)
+	{
+		size_t length = key.size / key.unit_size;
+		if (length > kMaxMeasuredLength || Find(key) >= 0)
+			return;
+
+		if (m_buckets.empty())
+		{
+			m_entries.reserve(kCapacity);
+			m_buckets.assign(kBucketCount, -1);
+		}
+
+		int index;
+		if (m_used < (int)m_entries.size())
+		{
+			index = m_used++; // Left over from before the last Clear
+		}
+		else if (m_used < kCapacity)
+		{
+			m_entries.emplace_back();
+			index = m_used++;
+		}
+		else
+		{
+			index = m_last;
+			Unlink(index);
+			Unchain(index);
+			Release(index);
+		}
+
+		// Assignment keeps the buffers of a recycled entry if they are large enough.
+		Entry& entry = m_entries[index];
+		entry.data.assign((const char*)key.data, key.size);
+		entry.unit_size = key.unit_size;
+		entry.font_offset = key.font_offset;
+		entry.width = key.width;
+		entry.raw = key.raw;
+		entry.hash = key.hash;
+		entry.complete = length <= kMaxTextLength;
+		if (entry.complete)
+		{
+			entry.value.ops = text.ops;
+			entry.value.lines = text.lines;
+		}
+		else
+		{
+			entry.value.ops.clear();
+			entry.value.lines.clear();
+		}
+		entry.value.size = text.size;
+		entry.value.cacheable = text.cacheable;
+		entry.value.substituted = text.substituted;
+		m_substitutions |= text.substituted;
+
+		int& bucket = m_buckets[key.hash % kBucketCount];
+		entry.chain = bucket;
+		bucket = index;
+		Link(index);
+	}
+
+	bool MarkupCache::HasSubstitutions() const
+	{
+		return m_substitutions;
+	}
+
+	void MarkupCache::Clear()
+	{
+		if (!m_buckets.empty())
+			m_buckets.assign(kBucketCount, -1);
+		for (int i = 0; i < (int)m_entries.size(); i++)
+			Release(i);
+		m_used = 0;
+		m_first = m_last = -1;
+		m_substitutions = false;
+	}
+}
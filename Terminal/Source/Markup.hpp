@@ -0,0 +1,169 @@
+/*
+* BearLibTerminal
+* Copyright (C) 2013-2017 Cfyz
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+* of the Software, and to permit persons to whom the Software is furnished to do
+* so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+* COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+* IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+* CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BEARLIBTERMINAL_MARKUP_HPP
+#define BEARLIBTERMINAL_MARKUP_HPP
+
+#include "Size.hpp"
+#include "Point.hpp"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace BearLibTerminal
+{
+	// Single step of a parsed print string. Everything that can be resolved
+	// at parse time (colors, fonts, substitutions, tile spacing) already is.
+	struct MarkupOp
+	{
+		enum Kind {Symbol, Combine, Break, Color, BkColor, ResetColor, ResetBkColor, Offset, ResetOffset};
+
+		MarkupOp(Kind kind, uint32_t value = 0);
+
+		Kind kind;
+		uint32_t value; // Symbol, Combine: code; Break: code of a hyphen or 0; Color, BkColor: color
+		Size spacing;   // Symbol, Break
+		Point offset;   // Offset; Symbol: position within the cell if proportional
+		int advance;    // Symbol, Break: in 1/64 of a pixel if the font is proportional, otherwise 0
+	};
+
+	// Print string parsed and split into lines, ready to be put or measured.
+	struct CompiledText
+	{
+		CompiledText();
+
+		struct Line
+		{
+			size_t first, last; // Range of ops
+			Size size;
+		};
+
+		std::vector<MarkupOp> ops;
+		std::vector<Line> lines;
+		Size size;
+		bool cacheable;   // False if substituted something that changes on its own (clipboard)
+		bool substituted; // Has configuration values substituted
+	};
+
+	// Splits the lines of the text so that none is wider than the width (unless a single
+	// symbol is). Works in one pass over the ops. Line breaks are placed after spaces and
+	// hyphens, around ideographs and at explicit break ops: zero width space, or soft
+	// hyphen which becomes a visible hyphen symbol when the line is broken there.
+	void WrapText(CompiledText& text, int width, std::vector<CompiledText::Line>& scratch);
+
+	// Lays out the symbols of proportional fonts (those with an advance) by their advances
+	// within every line, setting their spacing in cells and offset within the cell. A run
+	// of such symbols takes the cells it covers, so symbols after it stay on the grid.
+	void PlaceProportionalSymbols(CompiledText& text, int cell_width);
+
+	// Everything besides the terminal options that affects the result of parsing.
+	// The text is kept as it was passed in (any encoding), so looking it up does
+	// not require decoding. Does not own the text, it only has to outlive the lookup.
+	struct MarkupKey
+	{
+		template<typename CharT> MarkupKey(const CharT* text, size_t length, char32_t font_offset, int width, bool raw);
+
+		const void* data;
+		size_t size;    // In bytes
+		int unit_size;  // Size of a code unit of the encoding
+		char32_t font_offset;
+		int width;
+		bool raw;
+		size_t hash;
+	};
+
+	template<typename CharT> MarkupKey::MarkupKey(const CharT* text, size_t length, char32_t font_offset, int width, bool raw):
+		data(text),
+		size(length * sizeof(CharT)),
+		unit_size(sizeof(CharT)),
+		font_offset(font_offset),
+		width(width),
+		raw(raw)
+	{
+		// FNV-1a over the code units, then the rest of the key mixed in.
+		uint64_t value = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; i++)
+		{
+			value ^= (uint32_t)text[i];
+			value *= 1099511628211ULL;
+		}
+		value ^= font_offset + ((uint64_t)width << 32) + ((uint64_t)unit_size << 8) + raw;
+		value *= 1099511628211ULL;
+		hash = (size_t)(value ^ (value >> 32));
+	}
+
+	// Recently printed strings in their compiled form. Options, palette, fonts and
+	// tilesets are all baked into the compiled text so the owner must clear the
+	// cache whenever any of them changes.
+	//
+	// Strings too long to be worth keeping compiled are still remembered measured,
+	// so that measuring them again is cheap. Such entries have no ops or lines.
+	//
+	// Entries are never freed, only recycled (least recently used first), and the
+	// index is made of plain bucket chains, so once the cache has warmed up neither
+	// hits nor misses touch the heap. The exception is the text of measured-only
+	// entries, which is let go of when they are recycled or cleared, so that a few
+	// long strings do not keep their memory forever.
+	class MarkupCache
+	{
+	public:
+		MarkupCache();
+		const CompiledText* Get(const MarkupKey& key, bool measure_only);
+		void Add(const MarkupKey& key, const CompiledText& text);
+		bool HasSubstitutions() const;
+		void Clear();
+
+		static const int kCapacity = 256;
+		static const int kBucketCount = 512;
+		static const size_t kMaxTextLength = 1024;      // Longer strings are only kept measured
+		static const size_t kMaxMeasuredLength = 4096;  // And these are not kept at all
+
+	private:
+		struct Entry
+		{
+			std::string data;
+			int unit_size;
+			char32_t font_offset;
+			int width;
+			bool raw;
+			size_t hash;
+			bool complete; // Has ops and lines, not just the size
+			CompiledText value;
+			int prev, next; // Recently used list
+			int chain;      // Next entry in the same bucket
+		};
+
+		int Find(const MarkupKey& key) const;
+		void Release(int index);
+		void Link(int index);
+		void Unlink(int index);
+		void Unchain(int index);
+
+		std::vector<Entry> m_entries;
+		std::vector<int> m_buckets;
+		int m_used;
+		int m_first, m_last; // Most and least recently used entries
+		bool m_substitutions;
+	};
+}
+
+#endif // BEARLIBTERMINAL_MARKUP_HPP
@@ -135,15 +135,33 @@ namespace BearLibTerminal
 		return Convert(hsv);
 	}
 
-	Color Palette::Get(std::wstring name)
+	static bool ParseHexLiteral(const std::wstring& name, uint32_t& value)
 	{
-		if (name.empty())
-			return Color{255, 255, 255};
+		size_t length = name.length() - 1;
+		if (length != 6 && length != 8)
+			return false;
 
-		auto i = m_colors.find(name);
-		if (i != m_colors.end())
-			return i->second;
+		value = 0;
+		for (size_t i = 1; i <= length; i++)
+		{
+			wchar_t c = name[i];
+			if (c >= L'0' && c <= L'9')
+				value = (value << 4) | (c - L'0');
+			else if (c >= L'a' && c <= L'f')
+				value = (value << 4) | (c - L'a' + 10);
+			else if (c >= L'A' && c <= L'F')
+				value = (value << 4) | (c - L'A' + 10);
+			else
+				return false;
+		}
+
+		if (!(value & 0xFF000000))
+			value |= 0xFF000000;
+		return true;
+	}
 
+	static Color Parse(std::wstring name)
+	{
 		try
 		{
 			// Split '[shade ]name' color description
@@ -197,8 +215,36 @@ namespace BearLibTerminal
 		return Color{255, 255, 255};
 	}
 
+	Color Palette::Get(const std::wstring& name)
+	{
+		if (name.empty())
+			return Color{255, 255, 255};
+
+		// #RRGGBB and #AARRGGBB literals are by far the most common and need no lookup.
+		uint32_t value;
+		if (name[0] == L'#' && ParseHexLiteral(name, value))
+			return Color{value};
+
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto i = m_colors.find(name);
+		if (i != m_colors.end())
+			return i->second;
+
+		// Parsed forms do not depend on the palette, so they never go stale: a color
+		// named later is found in m_colors first.
+		auto j = m_parsed.find(name);
+		if (j != m_parsed.end())
+			return j->second;
+
+		if (m_parsed.size() >= kMaxParsedColors)
+			m_parsed.clear();
+		return m_parsed[name] = Parse(name);
+	}
+
 	void Palette::Set(std::wstring name, Color base)
 	{
+		std::lock_guard<std::mutex> guard(m_lock);
 		m_colors[name] = base;
 		for (std::wstring shade: {L"darkest", L"darker", L"dark", L"light", L"lighter", L"lightest"})
 			m_colors[shade + L" " + name] = Shade(base, shade);
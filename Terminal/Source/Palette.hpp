@@ -25,6 +25,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <mutex>
 #include "Color.hpp"
 
 namespace BearLibTerminal
@@ -33,12 +34,15 @@ namespace BearLibTerminal
 	{
 	public:
 		Palette();
-		Color Get(std::wstring name);
+		Color Get(const std::wstring& name);
 		void Set(std::wstring name, Color base);
 		static Palette Instance;
+		static const size_t kMaxParsedColors = 1024;
 
 	protected:
 		std::unordered_map<std::wstring, Color> m_colors;
+		std::unordered_map<std::wstring, Color> m_parsed; // Numeric and shaded numeric forms
+		std::mutex m_lock; // Bitmap tilesets may look up colors on worker threads
 	};
 }
 
@@ -22,6 +22,7 @@
 
 #include "Stage.hpp"
 #include "BearLibTerminal.h"
+#include <algorithm>
 
 namespace BearLibTerminal
 {
@@ -33,10 +34,221 @@ namespace BearLibTerminal
 		reserved(0)
 	{ }
 
-	Layer::Layer(Size size):
-		cells(size.Area())
+	Layer::Storage::Storage():
+		generation(1),
+		allocated(0)
 	{ }
 
+	Layer::Layer(Size size, Kind kind):
+		m_size(size),
+		m_kind(kind),
+		m_chunk_columns((size.width + kChunkSize - 1) >> kChunkShift),
+		m_storage(std::make_shared<Storage>())
+	{
+		if (m_kind == Kind::Dense)
+		{
+			m_storage->cells.resize(size.Area());
+			m_storage->stamps.resize(size.height);
+		}
+		else
+		{
+			m_storage->chunks.resize(m_chunk_columns * ((size.height + kChunkSize - 1) >> kChunkShift));
+			m_storage->stamps.resize(m_storage->chunks.size());
+		}
+	}
+
+	Size Layer::GetSize() const
+	{
+		return m_size;
+	}
+
+	bool Layer::IsVirtual() const
+	{
+		return m_kind == Kind::Virtual;
+	}
+
+	bool Layer::IsEmpty() const
+	{
+		return m_storage->allocated == 0;
+	}
+
+	bool Layer::IsCurrent(size_t index) const
+	{
+		return m_storage->stamps[index] == m_storage->generation;
+	}
+
+	void Layer::Renew(size_t index, Cell* cells, size_t count)
+	{
+		// Whatever is left from the previous generations goes now.
+		for (size_t i = 0; i < count; i++)
+			cells[i].leafs.clear();
+		m_storage->stamps[index] = m_storage->generation;
+		m_storage->allocated += 1;
+	}
+
+	void Layer::Unshare()
+	{
+		if (m_storage.use_count() > 1)
+			m_storage = std::make_shared<Storage>(*m_storage);
+	}
+
+	size_t Layer::GetChunkIndex(int x, int y) const
+	{
+		return (y >> kChunkShift)*m_chunk_columns + (x >> kChunkShift);
+	}
+
+	const Cell* Layer::Find(int x, int y) const
+	{
+		int length = 1;
+		return FindRun(x, y, length);
+	}
+
+	const Cell* Layer::FindRun(int x, int y, int& length) const
+	{
+		if (m_kind == Kind::Dense)
+			return IsCurrent(y)? &m_storage->cells[y*m_size.width+x]: nullptr;
+
+		length = (std::min)(length, kChunkSize - (x & (kChunkSize-1)));
+		size_t index = GetChunkIndex(x, y);
+		if (!IsCurrent(index))
+			return nullptr;
+		return &m_storage->chunks[index][((y & (kChunkSize-1)) << kChunkShift) + (x & (kChunkSize-1))];
+	}
+
+	Cell& Layer::MutableAt(int x, int y)
+	{
+		int length = 1;
+		return *MutableRun(x, y, length);
+	}
+
+	Cell* Layer::MutableRun(int x, int y, int& length, bool allocate)
+	{
+		Unshare();
+
+		if (m_kind == Kind::Dense)
+		{
+			Cell* row = &m_storage->cells[y*m_size.width];
+			if (!IsCurrent(y))
+			{
+				if (!allocate)
+					return nullptr;
+				Renew(y, row, m_size.width);
+			}
+			return row + x;
+		}
+
+		length = (std::min)(length, kChunkSize - (x & (kChunkSize-1)));
+		size_t index = GetChunkIndex(x, y);
+		auto& chunk = m_storage->chunks[index];
+		if (!IsCurrent(index))
+		{
+			if (!allocate)
+				return nullptr;
+			if (chunk.empty())
+				chunk.resize(kChunkSize*kChunkSize);
+			Renew(index, &chunk[0], chunk.size());
+		}
+		return &chunk[((y & (kChunkSize-1)) << kChunkShift) + (x & (kChunkSize-1))];
+	}
+
+	void Layer::Clear()
+	{
+		if (m_storage->allocated == 0)
+			return;
+
+		if (m_storage.use_count() > 1)
+		{
+			// No point in copying what is going to be cleared anyway.
+			m_storage = Layer(m_size, m_kind).m_storage;
+			return;
+		}
+
+		if (++m_storage->generation == 0)
+		{
+			// Wrapped around, old stamps might look current again.
+			std::fill(m_storage->stamps.begin(), m_storage->stamps.end(), 0);
+			m_storage->generation = 1;
+		}
+		m_storage->allocated = 0;
+	}
+
+	void Layer::Assign(const Layer& other)
+	{
+		if (m_kind != other.m_kind || m_size != other.m_size)
+			*this = Layer(other.m_size, other.m_kind);
+
+		if (m_storage != other.m_storage && !(IsEmpty() && other.IsEmpty()))
+		{
+			if (m_storage.use_count() > 1)
+				*this = Layer(other.m_size, other.m_kind);
+
+			// Only the current rows or chunks are copied, the stale ones are left
+			// as they are. Copy-assigning keeps the leaf buffers this layer already has.
+			Storage& target = *m_storage;
+			const Storage& source = *other.m_storage;
+			for (size_t i = 0; i < source.stamps.size(); i++)
+			{
+				if (source.stamps[i] != source.generation)
+					continue;
+
+				if (m_kind == Kind::Dense)
+				{
+					auto first = source.cells.begin() + i*m_size.width;
+					std::copy(first, first + m_size.width, target.cells.begin() + i*m_size.width);
+				}
+				else
+				{
+					target.chunks[i] = source.chunks[i];
+				}
+			}
+			target.stamps = source.stamps;
+			target.generation = source.generation;
+			target.allocated = source.allocated;
+		}
+		crop = other.crop;
+		offset = other.offset;
+	}
+
+	void Layer::AssignViewport(const Layer& other, Size size)
+	{
+		if (m_kind != Kind::Dense || m_size != size)
+			*this = Layer(size);
+		Clear();
+
+		for (int y = 0; y < size.height; y++)
+		{
+			int source_y = other.origin.y + y;
+			bool inside = source_y >= 0 && source_y < other.m_size.height;
+
+			// Parts of the row outside of the layer or in unallocated chunks are empty,
+			// and rows with nothing in them are left stale.
+			for (int x = 0, length; x < size.width; x += length)
+			{
+				int source_x = other.origin.x + x;
+				const Cell* run = nullptr;
+				length = size.width - x;
+
+				if (inside && source_x < 0)
+				{
+					length = (std::min)(length, -source_x);
+				}
+				else if (inside && source_x < other.m_size.width)
+				{
+					length = (std::min)(length, other.m_size.width - source_x);
+					run = other.FindRun(source_x, source_y, length);
+				}
+
+				if (run)
+				{
+					Cell* target = MutableRun(x, y, length);
+					std::copy(run, run + length, target);
+				}
+			}
+		}
+		crop = other.crop;
+		offset = other.offset;
+	}
+
 	void Stage::Resize(Size new_size)
 	{
 		size = new_size;
@@ -51,14 +263,36 @@ namespace BearLibTerminal
 		}
 		else
 		{
-			// Must preserve number of layers since who knows what layer is currently selected
-			for (auto& i: backbuffer.layers) i = Layer(size);
+			// Must preserve number of layers since who knows what layer is currently selected.
+			// Virtual layers do not depend on the window size and are kept as they are.
+			for (size_t i = 0; i < backbuffer.layers.size(); i++)
+			{
+				if (!backbuffer.layers[i].IsVirtual())
+					backbuffer.layers[i] = Layer(size, i == 0? Layer::Kind::Dense: Layer::Kind::Sparse);
+			}
 		}
 
-		// TODO: unnecessary?
+		// The window may be redrawn before the next refresh. Virtual layers are only
+		// ever drawn through their viewports, so this is not a plain copy.
 		if (frontbuffer.background.size() != backbuffer.background.size())
 		{
-			frontbuffer = backbuffer;
+			Present();
+		}
+	}
+
+	void Stage::Present()
+	{
+		frontbuffer.background = backbuffer.background;
+
+		auto& front = frontbuffer.layers;
+		auto& back = backbuffer.layers;
+		front.resize(back.size(), Layer(Size()));
+		for (size_t i = 0; i < back.size(); i++)
+		{
+			if (back[i].IsVirtual())
+				front[i].AssignViewport(back[i], size);
+			else
+				front[i].Assign(back[i]);
 		}
 	}
 
@@ -48,11 +48,62 @@ namespace BearLibTerminal
 		std::vector<Leaf> leafs;
 	};
 
+	// Cell storage of a layer is shared between copies (snapshots) until one
+	// of them is modified, so copying a layer is cheap.
+	//
+	// The first layer is dense: the size of the window, with cells stored in one
+	// row-major array. Others are sparse, with cells stored in square chunks that
+	// are only allocated once something is put into them, so that unused layers
+	// cost next to nothing. A virtual layer is a sparse one of its own size, only
+	// a viewport of which, starting at its origin, is shown in the window.
+	//
+	// Clearing a layer does not touch the cells. Every row (dense) or chunk
+	// (sparse) is stamped with the generation of the layer it was last written
+	// in, and clearing starts a new generation, so that all of them read as
+	// empty. A stale row or chunk is reset on the first write into it, keeping
+	// the memory it had.
 	struct Layer
 	{
-		Layer(Size size);
-		std::vector<Cell> cells;
+		enum class Kind {Dense, Sparse, Virtual};
+
+		Layer(Size size, Kind kind = Kind::Dense);
+		Size GetSize() const;
+		bool IsVirtual() const;
+		bool IsEmpty() const; // Nothing was written to since the layer was cleared
+		const Cell* Find(int x, int y) const; // Null if the row or chunk was not written to since
+		const Cell* FindRun(int x, int y, int& length) const; // Up to length contiguous cells
+		Cell& MutableAt(int x, int y);
+		Cell* MutableRun(int x, int y, int& length, bool allocate = true);
+		void Clear();
+		void Assign(const Layer& other); // Deep copy of a non-virtual layer, reusing own storage
+		void AssignViewport(const Layer& other, Size size); // A dense copy of what is shown of a virtual layer
 		Rectangle crop;
+		Point offset; // In pixels, the whole layer is drawn shifted by it
+		Point origin; // In cells, the top-left cell of a virtual layer shown in the window
+
+		static const int kChunkShift = 5;
+		static const int kChunkSize = 1 << kChunkShift; // Chunks are kChunkSize x kChunkSize cells
+
+	private:
+		struct Storage
+		{
+			Storage();
+			std::vector<Cell> cells;
+			std::vector<std::vector<Cell>> chunks; // Unallocated ones are empty
+			std::vector<uint32_t> stamps; // Generation of each row (dense) or chunk (sparse)
+			uint32_t generation; // Never 0, so that a stamp of 0 is always stale
+			int allocated; // Number of rows or chunks of the current generation
+		};
+
+		void Unshare();
+		bool IsCurrent(size_t index) const;
+		void Renew(size_t index, Cell* cells, size_t count);
+		size_t GetChunkIndex(int x, int y) const;
+
+		Size m_size;
+		Kind m_kind;
+		int m_chunk_columns;
+		std::shared_ptr<Storage> m_storage;
 	};
 
 	struct Scene
@@ -67,6 +118,7 @@ namespace BearLibTerminal
 		Scene frontbuffer;
 		Scene backbuffer;
 		void Resize(Size size);
+		void Present(); // Copies backbuffer to frontbuffer
 	};
 
 	struct State
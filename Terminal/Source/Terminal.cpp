@@ -31,6 +31,7 @@
 #include <limits>
 #include <cmath>
 #include <future>
+#include <iterator>
 #include <vector>
 #include <locale.h>
 
@@ -169,7 +170,8 @@ namespace BearLibTerminal
 			{L"mouse-move", TK_MOUSE_MOVE},
 			{L"mouse-scroll", TK_MOUSE_SCROLL},
 			{L"close", TK_CLOSE},
-			{L"resized", TK_RESIZED}
+			{L"resized", TK_RESIZED},
+			{L"tileset-loaded", TK_TILESET_LOADED}
 		};
 
 		auto i = mapping.find(name);
@@ -194,7 +196,8 @@ namespace BearLibTerminal
 		m_show_grid{false},
 		m_viewport_modified{false},
 		m_scale_step(kScaleDefault),
-		m_alt_pressed(false)
+		m_alt_pressed(false),
+		m_last_snapshot(0)
 	{
 #if defined(__APPLE__)
 		// OS X implementation of C-string manipulation routines (e. g. swprintf)
@@ -248,8 +251,11 @@ namespace BearLibTerminal
 
 	Terminal::~Terminal()
 	{
-		g_codespace.clear();
+		m_pending_tilesets.clear(); // Waits for the loaders to finish.
+		g_codespace.Clear();
 		g_tilesets.clear();
+		g_dynamic_tileset.reset();
+		g_previous_dynamic_tileset.reset();
 		g_atlas.Clear();
 
 		// Window will be disposed of automatically.
@@ -288,6 +294,7 @@ namespace BearLibTerminal
 		catch (std::exception& e)
 		{
 			LOG(Error, "Failed to set some options: " << e.what());
+			m_markup_cache.Clear(); // Some of the options might have been applied already
 			return 0;
 		}
 	}
@@ -378,9 +385,8 @@ namespace BearLibTerminal
 
 	TileInfo* GetTileInfo(char32_t code)
 	{
-		auto i = g_codespace.find(code);
-		if (i != g_codespace.end())
-			return i->second.get();
+		if (TileInfo* tile = g_codespace.Get(code))
+			return tile;
 
 		char32_t font_low = (code & Tileset::kFontOffsetMask);
 		char32_t font_high = font_low + Tileset::kCharOffsetMask;
@@ -395,8 +401,7 @@ namespace BearLibTerminal
 			if (j->second->Provides(code))
 			{
 				auto tile = j->second->Get(code);
-				g_codespace[code] = tile;
-				g_atlas.Add(tile);
+				MapTile(code, tile.get());
 				return tile.get();
 			}
 		}
@@ -406,8 +411,7 @@ namespace BearLibTerminal
 			if (g_dynamic_tileset)
 			{
 				auto tile = g_dynamic_tileset->Get(code);
-				g_codespace[code] = tile;
-				g_atlas.Add(tile);
+				MapTile(code, tile.get());
 				return tile.get();
 			}
 			else
@@ -426,8 +430,10 @@ namespace BearLibTerminal
 		auto groups = ParseOptions2(value);
 		Options updated = m_options;
 		std::unordered_map<char32_t, std::shared_ptr<Tileset>> new_tilesets;
+		std::map<char32_t, OptionGroup> async_tilesets;
 		std::unordered_map<std::wstring, Color> palette_update;
 		std::map<std::wstring, int> preallocated_fonts;
+		bool config_changed = false;
 
 		// Validate options
 		for (auto& group: groups)
@@ -466,6 +472,7 @@ namespace BearLibTerminal
 					// XXX: Just use section-property-value
 					Config::Instance().Set(group.name + L"." + i.first, i.second);
 				}
+				config_changed = true;
 			}
 			else if (group.name == L"palette")
 			{
@@ -477,11 +484,32 @@ namespace BearLibTerminal
 			else
 			{
 				char32_t offset = ParseTilesetOffset(group.name, preallocated_fonts);
+				bool async = false;
+				if (group.attributes.count(L"async") && !try_parse(group.attributes[L"async"], async))
+				{
+					throw std::runtime_error("Tileset: failed to parse 'async' attribute");
+				}
+
+				// The main font defines the cell size and so cannot be loaded lazily.
+				if (offset == 0)
+				{
+					async = false;
+				}
+
+				async_tilesets.erase(offset);
+				new_tilesets.erase(offset);
+
 				if (group.attributes[L"_"] == L"none")
 				{
 					// Remove tileset.
 					new_tilesets[offset].reset();
 				}
+				else if (async)
+				{
+					// Will be loaded in the background and swapped in by Refresh.
+					group.name = to_string<wchar_t>(offset);
+					async_tilesets[offset] = group;
+				}
 				else
 				{
 					// Add new tileset.
@@ -507,6 +535,33 @@ namespace BearLibTerminal
 		{
 			g_fonts[kv.first] = kv.second;
 		}
+		for (auto& pending: m_pending_tilesets)
+		{
+			// Superseded by a newer configuration of the same offset.
+			if (new_tilesets.count(pending.offset) || async_tilesets.count(pending.offset))
+				pending.discarded = true;
+		}
+		for (auto& kv: async_tilesets)
+		{
+			char32_t offset = kv.first;
+			OptionGroup group = kv.second;
+
+			// The palette belongs to this thread, so a named transparent color
+			// is resolved here and handed over to the loader as A,R,G,B.
+			auto transparent = group.attributes.find(L"transparent");
+			if (transparent != group.attributes.end() && transparent->second != L"auto" && transparent->second != L"false")
+			{
+				Color color = Palette::Instance.Get(transparent->second);
+				transparent->second =
+					to_string<wchar_t>((int)color.a) + L"," + to_string<wchar_t>((int)color.r) + L"," +
+					to_string<wchar_t>((int)color.g) + L"," + to_string<wchar_t>((int)color.b);
+			}
+
+			m_pending_tilesets.push_back(PendingTileset{offset, false, std::async(std::launch::async, [offset, group]() mutable
+			{
+				return Tileset::Create(group, offset);
+			})});
+		}
 		for (auto& kv: new_tilesets)
 		{
 			RemoveTileset(kv.first);
@@ -524,9 +579,7 @@ namespace BearLibTerminal
 		for (auto kv: palette_update)
 			Palette::Instance.Set(kv.first, kv.second);
 
-		Log::Instance().filename = updated.log_filename;
-		Log::Instance().level = updated.log_level;
-		Log::Instance().mode = updated.log_mode;
+		Log::Instance().Configure(updated.log_filename, updated.log_level, updated.log_mode);
 
 		if (updated.terminal_encoding != m_options.terminal_encoding)
 		{
@@ -660,6 +713,18 @@ namespace BearLibTerminal
 			m_window->SetFullscreen(updated.window_fullscreen);
 		}
 
+		// Compiled strings have tile spacing, fonts, colors, substitutions and some
+		// of the options baked in. Substitutions may refer to any option.
+		if (!new_tilesets.empty() || !preallocated_fonts.empty() || !palette_update.empty() || config_changed ||
+			cell_size_changed || updated.window_size != m_options.window_size ||
+			updated.terminal_encoding != m_options.terminal_encoding ||
+			updated.output_postformatting != m_options.output_postformatting ||
+			updated.output_tab_width != m_options.output_tab_width ||
+			m_markup_cache.HasSubstitutions())
+		{
+			m_markup_cache.Clear();
+		}
+
 		m_options = updated;
 
 		// Synchronize options struct with configuration cache (sys.group.option).
@@ -932,6 +997,7 @@ namespace BearLibTerminal
 		{
 			result.insert(TK_CLOSE);
 			result.insert(TK_RESIZED);
+			result.insert(TK_TILESET_LOADED);
 		}
 
 		out = result;
@@ -1009,11 +1075,13 @@ namespace BearLibTerminal
 
 		if (m_state != kVisible) return;
 
+		ApplyLoadedTilesets();
+
 		uint64_t time_copy_start;
 		// Synchronously copy backbuffer to frontbuffer
 		{
 			std::lock_guard<std::mutex> guard(m_lock);
-			m_world.stage.frontbuffer = m_world.stage.backbuffer;
+			m_world.stage.Present();
 		}
 
 		uint64_t time_invoke_start = gettime(), time_draw_start, time_swap_start, time_swap_end;
@@ -1064,12 +1132,58 @@ namespace BearLibTerminal
 			m_state = kVisible;
 		}
 
-		m_world.stage.frontbuffer = m_world.stage.backbuffer;
+		ApplyLoadedTilesets();
+		m_world.stage.Present();
 		m_window->PumpEvents();
 		Render();
 	}
 #endif
 
+	void Terminal::ApplyLoadedTilesets()
+	{
+		bool applied = false;
+
+		for (auto i = m_pending_tilesets.begin(); i != m_pending_tilesets.end(); )
+		{
+			if (i->result.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+			{
+				i++;
+				continue;
+			}
+
+			std::shared_ptr<Tileset> tileset;
+			try
+			{
+				tileset = i->result.get();
+			}
+			catch (std::exception& e)
+			{
+				LOG(Error, "Failed to load tileset " << (int)i->offset << ": " << e.what());
+			}
+
+			if (tileset && !i->discarded)
+			{
+				// Until now the codes were drawn with whatever tileset was providing them before.
+				RemoveTileset(i->offset);
+				AddTileset(tileset);
+				applied = true;
+			}
+
+			// Failures are reported too, so that every request gets its event.
+			if (!i->discarded)
+				PushEvent(Event(TK_TILESET_LOADED, {{TK_TILESET_OFFSET, (int)i->offset}, {TK_TILESET_STATUS, tileset? 1: 0}}));
+
+			i = m_pending_tilesets.erase(i);
+		}
+
+		if (applied)
+		{
+			g_atlas.Defragment();
+			g_atlas.CleanUp();
+			m_markup_cache.Clear();
+		}
+	}
+
 	void Terminal::Clear()
 	{
 		if (m_world.stage.backbuffer.background.size() != m_world.stage.size.Area())
@@ -1081,41 +1195,146 @@ namespace BearLibTerminal
 		{
 			for (auto& layer: m_world.stage.backbuffer.layers)
 			{
-				for (auto& cell: layer.cells)
-				{
-					cell.leafs.clear();
-				}
-
+				layer.Clear();
 				layer.crop = Rectangle();
+				layer.offset = Point();
 			}
 		}
 
-		for (auto& color: m_world.stage.backbuffer.background)
-		{
-			color = m_world.state.bkcolor;
-		}
+		// Unlike the cells, the background is a flat array of colors and filling
+		// it is about as cheap as keeping track of what is stale.
+		auto& background = m_world.stage.backbuffer.background;
+		std::fill(background.begin(), background.end(), m_world.state.bkcolor);
 	}
 
 	void Terminal::Clear(int x, int y, int w, int h)
 	{
-		Size stage_size = m_world.stage.size;
+		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		Size layer_size = layer.GetSize();
 		if (x < 0) x = 0;
 		if (y < 0) y = 0;
-		if (x+w >= stage_size.width) w = stage_size.width-x;
-		if (y+h >= stage_size.height) h = stage_size.height-y;
+		if (x+w >= layer_size.width) w = layer_size.width-x;
+		if (y+h >= layer_size.height) h = layer_size.height-y;
+
+		for (int j=y; j<y+h; j++)
+		{
+			// Chunks of virtual layers that were never written to are already clear.
+			for (int i=x, length; i<x+w; i+=length)
+			{
+				length = x+w-i;
+				if (Cell* run = layer.MutableRun(i, j, length, false))
+				{
+					for (int k=0; k<length; k++)
+						run[k].leafs.clear();
+				}
+			}
+
+			if (m_world.state.layer == 0 && w > 0)
+			{
+				auto row = m_world.stage.backbuffer.background.begin() + j*layer_size.width;
+				std::fill(row+x, row+x+w, m_world.state.bkcolor);
+			}
+		}
+	}
 
+	void Terminal::Scroll(int x, int y, int w, int h, int dx, int dy)
+	{
 		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
-		for (int i=x; i<x+w; i++)
+		Size layer_size = layer.GetSize();
+		Rectangle area = Rectangle(layer_size).Intersection(Rectangle(x, y, w, h));
+		if (w <= 0 || h <= 0 || area.width <= 0 || area.height <= 0 || (dx == 0 && dy == 0)) return;
+
+		auto& background = m_world.stage.backbuffer.background;
+		bool has_background = m_world.state.layer == 0;
+
+		// Part of the area that receives contents from elsewhere in the area.
+		Rectangle target = area.Intersection(Rectangle(area.left+dx, area.top+dy, area.width, area.height));
+		if (target.width <= 0 || target.height <= 0)
+			target = Rectangle(area.left, area.top, 0, 0);
+
+		// Cells are moved a run at a time in the order that never overwrites a cell yet
+		// to be moved, leaf storage changing hands instead of being copied. A run does
+		// not cross a chunk boundary either where it is taken from or where it goes to.
+		const int mask = Layer::kChunkSize-1;
+		for (int n = 0; n < target.height; n++)
 		{
-			for (int j=y; j<y+h; j++)
+			int j = dy > 0? target.top+target.height-1-n: target.top+n;
+			for (int m = 0, length; m < target.width; m += length)
 			{
-				int k = stage_size.width*j+i;
-				layer.cells[k].leafs.clear();
-				if (m_world.state.layer == 0)
+				int i; // Leftmost cell of the run
+				if (dx > 0)
+				{
+					int right = target.left+target.width-m;
+					i = (std::max)({target.left, (right-1) & ~mask, ((right-1-dx) & ~mask) + dx});
+					length = right-i;
+				}
+				else
+				{
+					i = target.left+m;
+					length = (std::min)({target.width-m, Layer::kChunkSize-(i & mask), Layer::kChunkSize-((i-dx) & mask)});
+				}
+
+				int source_length = length;
+				if (Cell* source = layer.MutableRun(i-dx, j-dy, source_length, false))
+				{
+					Cell* cells = layer.MutableRun(i, j, length);
+					if (dx > 0)
+					{
+						typedef std::reverse_iterator<Cell*> backwards;
+						std::swap_ranges(backwards(source+length), backwards(source), backwards(cells+length));
+					}
+					else
+					{
+						std::swap_ranges(source, source+length, cells);
+					}
+				}
+				else if (Cell* cells = layer.MutableRun(i, j, length, false))
 				{
-					m_world.stage.backbuffer.background[k] = m_world.state.bkcolor;
+					for (int k = 0; k < length; k++)
+						cells[k].leafs.clear();
 				}
 			}
+
+			if (has_background)
+			{
+				auto colors = background.begin();
+				int from = (j-dy)*layer_size.width + target.left-dx;
+				int to = j*layer_size.width + target.left;
+				if (dx > 0)
+					std::copy_backward(colors+from, colors+from+target.width, colors+to+target.width);
+				else
+					std::copy(colors+from, colors+from+target.width, colors+to);
+			}
+		}
+
+		// Whatever is left uncovered is cleared.
+		auto clear = [&](int j, int left, int right)
+		{
+			for (int i = left, length; i < right; i += length)
+			{
+				length = right-i;
+				if (Cell* run = layer.MutableRun(i, j, length, false))
+				{
+					for (int k = 0; k < length; k++)
+						run[k].leafs.clear();
+				}
+			}
+
+			if (has_background)
+				std::fill(background.begin() + j*layer_size.width+left, background.begin() + j*layer_size.width+right, m_world.state.bkcolor);
+		};
+
+		for (int j = area.top; j < area.top+area.height; j++)
+		{
+			if (j < target.top || j >= target.top+target.height)
+			{
+				clear(j, area.left, area.left+area.width);
+			}
+			else
+			{
+				clear(j, area.left, target.left);
+				clear(j, target.left+target.width, area.left+area.width);
+			}
 		}
 	}
 
@@ -1125,6 +1344,79 @@ namespace BearLibTerminal
 			Rectangle(m_world.stage.size).Intersection(Rectangle(x, y, w, h));
 	}
 
+	void Terminal::SetLayerOffset(int dx, int dy)
+	{
+		m_world.stage.backbuffer.layers[m_world.state.layer].offset = Point(dx, dy);
+	}
+
+	void Terminal::SetLayerSize(int width, int height)
+	{
+		static const int kMaxVirtualSize = 16384;
+
+		if (m_world.state.layer == 0)
+		{
+			// The first layer shares its cells with the background and has to match it.
+			LOG(Warning, "The first layer cannot be resized");
+			return;
+		}
+
+		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		if (width <= 0 || height <= 0)
+			layer = Layer(m_world.stage.size, Layer::Kind::Sparse);
+		else
+			layer = Layer(Size((std::min)(width, kMaxVirtualSize), (std::min)(height, kMaxVirtualSize)), Layer::Kind::Virtual);
+	}
+
+	void Terminal::SetLayerOrigin(int x, int y)
+	{
+		m_world.stage.backbuffer.layers[m_world.state.layer].origin = Point(x, y);
+	}
+
+	int Terminal::SnapshotLayer(int layer_index)
+	{
+		if (layer_index < 0) layer_index = 0;
+		if (layer_index > 255) layer_index = 255;
+
+		auto& layers = m_world.stage.backbuffer.layers;
+		Snapshot snapshot
+		{
+			layer_index,
+			layer_index < (int)layers.size()? layers[layer_index]: Layer(m_world.stage.size, Layer::Kind::Sparse),
+			layer_index == 0? m_world.stage.backbuffer.background: std::vector<Color>()
+		};
+
+		int handle = ++m_last_snapshot;
+		m_snapshots.emplace(handle, std::move(snapshot));
+		return handle;
+	}
+
+	void Terminal::RestoreLayer(int handle)
+	{
+		auto i = m_snapshots.find(handle);
+		if (i == m_snapshots.end())
+			return;
+
+		Snapshot& snapshot = i->second;
+		if (!snapshot.contents.IsVirtual() && snapshot.contents.GetSize() != m_world.stage.size)
+		{
+			LOG(Warning, "Layer snapshot " << handle << " was taken before the window was resized and cannot be restored");
+			return;
+		}
+
+		auto& layers = m_world.stage.backbuffer.layers;
+		while ((int)layers.size() <= snapshot.layer)
+			layers.emplace_back(m_world.stage.size, Layer::Kind::Sparse);
+		layers[snapshot.layer] = snapshot.contents;
+
+		if (snapshot.layer == 0)
+			m_world.stage.backbuffer.background = snapshot.background;
+	}
+
+	void Terminal::ReleaseSnapshot(int handle)
+	{
+		m_snapshots.erase(handle);
+	}
+
 	void Terminal::SetLayer(int layer_index)
 	{
 		// Layer index is limited to [0..255]
@@ -1135,7 +1427,7 @@ namespace BearLibTerminal
 
 		while (m_world.stage.backbuffer.layers.size() <= m_world.state.layer)
 		{
-			m_world.stage.backbuffer.layers.emplace_back(m_world.stage.size);
+			m_world.stage.backbuffer.layers.emplace_back(m_world.stage.size, Layer::Kind::Sparse);
 		}
 	}
 
@@ -1175,19 +1467,17 @@ namespace BearLibTerminal
 
 	void Terminal::PutInternal(int x, int y, int dx, int dy, char32_t code, Color* colors)
 	{
-		if (x < 0 || y < 0 || x >= m_world.stage.size.width || y >= m_world.stage.size.height) return;
+		// NOTE: layer must be already allocated by SetLayer
+		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		if (x < 0 || y < 0 || x >= layer.GetSize().width || y >= layer.GetSize().height) return;
 
 		// Prepare tile if necessary.
-		TileInfo* tile_info = nullptr;
-		auto it = g_codespace.find(code);
-		if (it != g_codespace.end())
-			tile_info = it->second.get();
-		else
+		TileInfo* tile_info = g_codespace.Get(code);
+		if (!tile_info)
 			tile_info = GetTileInfo(code);
 
-		// NOTE: layer must be already allocated by SetLayer
 		int index = y*m_world.stage.size.width+x;
-		Cell& cell = m_world.stage.backbuffer.layers[m_world.state.layer].cells[index];
+		Cell& cell = layer.MutableAt(x, y);
 
 		if (code != 0)
 		{
@@ -1255,15 +1545,169 @@ namespace BearLibTerminal
 		PutInternal(x, y, dx, dy, m_world.state.font_offset + code, corners);
 	}
 
+	void Terminal::PutArray(int x, int y, int w, int h, const int* codes, const Color* fg, const Color* bg, int stride)
+	{
+		if (!codes || w <= 0 || h <= 0) return;
+		if (stride <= 0) stride = w;
+
+		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		Size stage_size = m_world.stage.size, layer_size = layer.GetSize();
+		int left = (std::max)(x, 0), top = (std::max)(y, 0);
+		int right = (std::min)(x+w, layer_size.width), bottom = (std::min)(y+h, layer_size.height);
+
+		auto& background = m_world.stage.backbuffer.background;
+		bool paint_background = m_world.state.layer == 0;
+
+		// Maps usually repeat the same few codes, so the tile of the previous one is kept
+		// around instead of converting and looking up every code anew.
+		int previous = 0;
+		char32_t code = 0;
+		TileInfo* tile_info = nullptr;
+
+		for (int j = top; j < bottom; j++)
+		{
+			// Cells are stored contiguously in runs (a chunk wide at most for virtual layers).
+			for (int start = left, length; start < right; start += length)
+			{
+				length = right-start;
+				Cell* run = layer.MutableRun(start, j, length);
+				for (int i = start; i < start+length; i++)
+				{
+					size_t source = (size_t)(j-y)*stride + (i-x);
+					int index = j*stage_size.width + i;
+					Cell& cell = run[i-start];
+
+					if (!tile_info || codes[source] != previous)
+					{
+						previous = codes[source];
+						code = m_world.state.font_offset + (m_options.terminal_encoding_affects_put? m_encoding->Convert(previous): previous);
+						tile_info = g_codespace.Get(code);
+						if (!tile_info)
+							tile_info = GetTileInfo(code);
+					}
+
+					if (code == 0)
+					{
+						// Character code '0' means 'erase cell'
+						cell.leafs.clear();
+						if (paint_background)
+							background[index] = Color();
+						continue;
+					}
+
+					if (m_world.state.composition == TK_OFF)
+						cell.leafs.clear();
+
+					cell.leafs.emplace_back();
+					Leaf& leaf = cell.leafs.back();
+					leaf.code = code;
+					leaf.dx = leaf.dy = 0;
+					leaf.color[0] = fg? fg[source]: m_world.state.color;
+
+					Color bkcolor = bg? bg[source]: m_world.state.bkcolor;
+					if (paint_background && bkcolor)
+					{
+						if (tile_info->spacing.width == 1 && tile_info->spacing.height == 1)
+						{
+							background[index] = bkcolor;
+							continue;
+						}
+
+						for (int by = j; by < (std::min)(j+tile_info->spacing.height, stage_size.height); by++)
+						{
+							for (int bx = i; bx < (std::min)(i+tile_info->spacing.width, stage_size.width); bx++)
+							{
+								background[by*stage_size.width+bx] = bkcolor;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void Terminal::Fill(int x, int y, int w, int h, int code, Color fg, Color bg)
+	{
+		if (w <= 0 || h <= 0) return;
+
+		Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		Rectangle area = Rectangle(layer.GetSize()).Intersection(Rectangle(x, y, w, h));
+		if (area.width <= 0 || area.height <= 0) return;
+
+		if (m_options.terminal_encoding_affects_put)
+			code = m_encoding->Convert(code);
+		char32_t symbol = m_world.state.font_offset + code;
+
+		TileInfo* tile_info = g_codespace.Get(symbol);
+		if (!tile_info)
+			tile_info = GetTileInfo(symbol);
+
+		for (int j = area.top; j < area.top+area.height; j++)
+		{
+			for (int start = area.left, length; start < area.left+area.width; start += length)
+			{
+				length = area.left+area.width-start;
+				Cell* run = layer.MutableRun(start, j, length, symbol != 0);
+				if (!run)
+					continue;
+
+				for (auto i = run; i != run+length; i++)
+				{
+					if (symbol == 0 || m_world.state.composition == TK_OFF)
+						i->leafs.clear();
+					if (symbol == 0)
+						continue;
+
+					i->leafs.emplace_back();
+					Leaf& leaf = i->leafs.back();
+					leaf.code = symbol;
+					leaf.dx = leaf.dy = 0;
+					leaf.color[0] = fg;
+				}
+			}
+		}
+
+		if (m_world.state.layer == 0)
+		{
+			if (symbol == 0)
+			{
+				// Character code '0' means 'erase cell'
+				FillBackColor(area.left, area.top, area.width, area.height, Color());
+			}
+			else if (bg)
+			{
+				// Every tile paints the background under its whole spacing, which together
+				// is the area grown by the spacing less one cell.
+				FillBackColor(area.left, area.top, area.width+tile_info->spacing.width-1, area.height+tile_info->spacing.height-1, bg);
+			}
+		}
+	}
+
+	void Terminal::FillBackColor(int x, int y, int w, int h, Color bg)
+	{
+		if (w <= 0 || h <= 0) return;
+
+		Size stage_size = m_world.stage.size;
+		Rectangle area = Rectangle(stage_size).Intersection(Rectangle(x, y, w, h));
+		if (area.width <= 0 || area.height <= 0) return;
+
+		auto& background = m_world.stage.backbuffer.background;
+		for (int j = area.top; j < area.top+area.height; j++)
+		{
+			auto row = background.begin() + j*stage_size.width + area.left;
+			std::fill(row, row + area.width, bg);
+		}
+	}
+
 	int Terminal::Pick(int x, int y, int index)
 	{
-		if (x < 0 || y < 0 || x >= m_world.stage.size.width || y >= m_world.stage.size.height) return 0;
+		const Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		if (x < 0 || y < 0 || x >= layer.GetSize().width || y >= layer.GetSize().height) return 0;
 
-		int cell_index = y * m_world.stage.size.width + x;
-		auto& cell = m_world.stage.backbuffer.layers[m_world.state.layer].cells[cell_index];
+		const Cell* cell = layer.Find(x, y);
 		wchar_t code = 0;
-		if (index >= 0 && index < (int)cell.leafs.size())
-			code = (int)(cell.leafs[index].code & Tileset::kCharOffsetMask);
+		if (cell && index >= 0 && index < (int)cell->leafs.size())
+			code = (int)(cell->leafs[index].code & Tileset::kCharOffsetMask);
 
 		// Must take into account possible terminal.encoding codepage.
 		int translated = m_encoding->Convert(code);
@@ -1272,11 +1716,11 @@ namespace BearLibTerminal
 
 	Color Terminal::PickForeColor(int x, int y, int index)
 	{
-		if (x < 0 || y < 0 || x >= m_world.stage.size.width || y >= m_world.stage.size.height) return Color();
+		const Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
+		if (x < 0 || y < 0 || x >= layer.GetSize().width || y >= layer.GetSize().height) return Color();
 
-		int cell_index = y * m_world.stage.size.width + x;
-		auto& cell = m_world.stage.backbuffer.layers[m_world.state.layer].cells[cell_index];
-		return (index >= 0 && index < (int)cell.leafs.size())? cell.leafs[index].color[0]: Color();
+		const Cell* cell = layer.Find(x, y);
+		return (cell && index >= 0 && index < (int)cell->leafs.size())? cell->leafs[index].color[0]: Color();
 	}
 
 	Color Terminal::PickBackColor(int x, int y)
@@ -1287,67 +1731,38 @@ namespace BearLibTerminal
 		return m_world.stage.backbuffer.background[cell_index];
 	}
 
-	struct Line
+	void Terminal::DecodeText(const char* str, size_t length, std::wstring& out)
 	{
-		struct Symbol
+		if (dynamic_cast<const UTF8Encoding*>(m_encoding.get()))
 		{
-			Symbol();
-			Symbol(int code);
-			Symbol(int code, Size spacing);
-			int code;
-			Size spacing;
-		};
-
-		Line();
-		void UpdateSize();
-		std::vector<Symbol> symbols;
-		Size size;
-	};
-
-	Line::Symbol::Symbol():
-		code(0)
-	{ }
-
-	Line::Symbol::Symbol(int code):
-		code(code)
-	{ }
-
-	Line::Symbol::Symbol(int code, Size spacing):
-		code(code),
-		spacing(spacing)
-	{ }
-
-	Line::Line():
-		size(0, 1)
-	{ }
-
-	void Line::UpdateSize()
-	{
-		for (auto& symbol: symbols)
+			Decode(str, length, out);
+		}
+		else
 		{
-			if (symbol.code <= 0)
-			{
-				continue;
-			}
-
-			size.width += symbol.spacing.width;
-			size.height = (std::max)(size.height, symbol.spacing.height);
+			for (size_t i = 0; i < length; i++)
+				out.push_back(m_encoding->Convert((int)(uint8_t)str[i]));
 		}
 	}
 
-	Size Terminal::Print(int x0, int y0, int w0, int h0, int align, std::wstring str, bool raw, bool measure_only)
+	template<typename CharT> void Terminal::DecodeText(const CharT* str, size_t length, std::wstring& out)
 	{
-		char32_t font_offset = m_world.state.font_offset;
-		bool combine = false;
-		Point offset = Point(0, 0);
-		Size wrap = Size{w0, h0};
-		State original_state = m_world.state;
+		Decode(str, length, out);
+	}
 
-		int x, y, w;
+	// Parses the string, expanding substitutions in place.
+	void Terminal::CompileText(std::wstring& str, char32_t font_offset, int width, bool raw, CompiledText& text)
+	{
+		bool combine = false;
+		auto& ops = text.ops;
+		auto& lines = text.lines;
+		ops.clear();
+		lines.clear();
+		lines.push_back(CompiledText::Line{0, 0, Size(0, 1)});
+		text.cacheable = true;
+		text.substituted = false;
 
-		std::vector<std::function<void()>> tags;
-		std::list<Line> lines;
-		lines.emplace_back();
+		std::wstring& name = m_print_scratch.name;
+		std::wstring& params = m_print_scratch.params;
 
 		auto GetTileSpacing = [&](char32_t code) -> Size
 		{
@@ -1357,6 +1772,31 @@ namespace BearLibTerminal
 			return Size(1, 1);
 		};
 
+		// Symbols of proportional fonts are kerned against the previous one of the same font.
+		const size_t kNone = (size_t)-1;
+		bool proportional = false;
+		size_t kerned = kNone;
+		Tileset* kerned_tileset = nullptr;
+
+		auto SetSymbolMetrics = [&](MarkupOp& op, char32_t code)
+		{
+			TileInfo* tile = GetTileInfo(code);
+			op.spacing = tile? tile->spacing: Size(1, 1);
+			op.advance = tile? tile->tileset->GetAdvance(code): 0;
+			if (op.advance == 0 || op.kind != MarkupOp::Symbol)
+				return;
+
+			if (kerned != kNone && kerned_tileset == tile->tileset)
+			{
+				MarkupOp& previous = ops[kerned];
+				previous.advance = (std::max)(previous.advance + tile->tileset->GetKerning(previous.value, code), 1);
+			}
+
+			proportional = true;
+			kerned = &op - &ops[0];
+			kerned_tileset = tile->tileset;
+		};
+
 		auto AppendSymbol = [&](char32_t wcode)
 		{
 			char32_t code = font_offset + wcode;
@@ -1366,22 +1806,26 @@ namespace BearLibTerminal
 				return;
 			}
 
-			if (combine)
+			if (wcode == 0x00AD) // Soft hyphen, only visible if a line is broken there
 			{
-				tags.push_back([&, code]
-				{
-					if (w == -1) return;
-					auto saved = m_world.state.composition;
-					m_world.state.composition = TK_ON;
-					PutInternal(w, y, offset.x, offset.y, code, nullptr);
-					m_world.state.composition = saved;
-				});
-				lines.back().symbols.emplace_back(-(int)(tags.size()-1));
+				ops.emplace_back(MarkupOp::Break, font_offset + L'-');
+				SetSymbolMetrics(ops.back(), font_offset + L'-');
+			}
+			else if (wcode == 0x200B) // Zero width space
+			{
+				ops.emplace_back(MarkupOp::Break);
+			}
+			else if (combine)
+			{
+				ops.emplace_back(MarkupOp::Combine, code);
 				combine = false;
 			}
 			else
 			{
-				lines.back().symbols.emplace_back((int)code, GetTileSpacing(code));
+				ops.emplace_back(MarkupOp::Symbol, code);
+				SetSymbolMetrics(ops.back(), code);
+				if (ops.back().advance == 0)
+					kerned = kNone;
 			}
 		};
 
@@ -1410,38 +1854,37 @@ namespace BearLibTerminal
 				size_t params_pos = str.find(L'=', i);
 				params_pos = (std::min)(closing_bracket_pos, (params_pos == std::wstring::npos)? str.length(): params_pos);
 
-				std::wstring name = str.substr(i, params_pos-i);
-				std::wstring params = (params_pos < closing_bracket_pos)? str.substr(params_pos+1, closing_bracket_pos-(params_pos+1)): std::wstring();
+				name.assign(str, i, params_pos-i);
+				if (params_pos < closing_bracket_pos)
+					params.assign(str, params_pos+1, closing_bracket_pos-(params_pos+1));
+				else
+					params.clear();
 				char32_t arbitrary_code = 0;
 
-				std::function<void()> tag;
-
 				if ((name == L"color" || name == L"c") && !params.empty())
 				{
-					color_t color = Palette::Instance.Get(params);
-					tag = [&, color]{m_world.state.color = color;};
+					ops.emplace_back(MarkupOp::Color, Palette::Instance.Get(params));
 				}
 				else if (name == L"/color" || name == L"/c")
 				{
-					tag = [&]{m_world.state.color = original_state.color;};
+					ops.emplace_back(MarkupOp::ResetColor);
 				}
 				else if ((name == L"bkcolor" || name == L"b") && !params.empty())
 				{
-					color_t color = Palette::Instance.Get(params);
-					tag = [&, color]{m_world.state.bkcolor = color;};
+					ops.emplace_back(MarkupOp::BkColor, Palette::Instance.Get(params));
 				}
 				else if (name == L"/bkcolor" || name == L"/b")
 				{
-					tag = [&]{m_world.state.bkcolor = original_state.bkcolor;};
+					ops.emplace_back(MarkupOp::ResetBkColor);
 				}
 				else if (name == L"offset")
 				{
-					Point value = parse<Point>(params);
-					tag = [&offset, value]{offset = value;};
+					ops.emplace_back(MarkupOp::Offset);
+					ops.back().offset = parse<Point>(params);
 				}
 				else if (name == L"/offset")
 				{
-					tag = [&offset]{offset = Point(0, 0);};
+					ops.emplace_back(MarkupOp::ResetOffset);
 				}
 				else if (name == L"+")
 				{
@@ -1466,9 +1909,12 @@ namespace BearLibTerminal
 				}
 				else
 				{
-					std::wstring subs;
+					std::wstring& subs = m_print_scratch.value;
 					if (Config::Instance().TryGet(name, subs))
 					{
+						if (name == L"clipboard")
+							text.cacheable = false;
+						text.substituted = true;
 						str.insert(closing_bracket_pos+1, subs);
 						if (str.length() > m_world.stage.size.Area())
 						{
@@ -1477,12 +1923,6 @@ namespace BearLibTerminal
 					}
 				}
 
-				if (tag)
-				{
-					tags.push_back(std::move(tag));
-					lines.back().symbols.emplace_back(-(int)(tags.size()-1));
-				}
-
 				i = closing_bracket_pos;
 			}
 			else if (c == L']' && !raw && m_options.output_postformatting)
@@ -1505,8 +1945,9 @@ namespace BearLibTerminal
 			}
 			else if (c == L'\n') // forced line-break
 			{
-				lines.emplace_back();
-				lines.back().size.height = GetTileSpacing(font_offset + L' ').height;
+				kerned = kNone;
+				lines.back().last = ops.size();
+				lines.push_back(CompiledText::Line{ops.size(), ops.size(), Size(0, GetTileSpacing(font_offset + L' ').height)});
 			}
 			else if (c == L'\r')
 			{
@@ -1518,75 +1959,93 @@ namespace BearLibTerminal
 			}
 		}
 
-		if (wrap.width > 0) // Auto-wrap the lines
+		lines.back().last = ops.size();
+
+		// Proportional symbols are laid out twice when wrapping: first to find out how
+		// much space they take, then once more so that every line starts at its left edge.
+		if (proportional)
 		{
-			for (auto i = lines.begin(); i != lines.end(); i++) // maybe, vector?
-			{
-				auto& line = *i;
+			PlaceProportionalSymbols(text, m_world.state.cellsize.width);
+		}
 
-				int length = 0, last_line_break = 0;
-				for (size_t j = 0; j < line.symbols.size(); j++)
-				{
-					Line::Symbol& s = line.symbols[j];
+		if (width > 0) // Auto-wrap the lines
+		{
+			WrapText(text, width, m_print_scratch.lines);
+			if (proportional)
+				PlaceProportionalSymbols(text, m_world.state.cellsize.width);
+		}
 
-					if (s.code <= 0) // tag reference
-					{
-						continue;
-					}
+		text.size = Size(0, 0);
+		for (auto& line: lines)
+		{
+			for (size_t j = line.first; j < line.last; j++)
+			{
+				if (ops[j].kind == MarkupOp::Symbol)
+				{
+					line.size.width += ops[j].spacing.width;
+					line.size.height = (std::max)(line.size.height, ops[j].spacing.height);
+				}
+			}
 
-					if (length + s.spacing.width > wrap.width) // cut off // FIXME: prove bounds correctness
-					{
-						if (last_line_break == 0)
-						{
-							// If there was no line-break characters in the line, cut the word in half.
-							// Current symbol makes work overflow so it cannot be left on this line.
-							last_line_break = j - 1;
-						}
+			text.size.height += line.size.height;
+			text.size.width = (std::max)(text.size.width, line.size.width);
+		}
+	}
 
-						int offset = last_line_break + 1;
-						int leave = offset;
+	Size Terminal::Print(int x, int y, int w, int h, int align, const char* str, bool raw, bool measure_only)
+	{
+		return PrintInternal(x, y, w, h, align, str, std::char_traits<char>::length(str), raw, measure_only);
+	}
 
-						if ((line.symbols[last_line_break].code & Tileset::kCharOffsetMask) == L' ')
-						{
-							leave -= 1;
-						}
+	Size Terminal::Print(int x, int y, int w, int h, int align, const char16_t* str, bool raw, bool measure_only)
+	{
+		return PrintInternal(x, y, w, h, align, str, std::char_traits<char16_t>::length(str), raw, measure_only);
+	}
 
-						auto copy = i;
-						Line next;
-						next.symbols = std::vector<Line::Symbol>(line.symbols.begin()+offset, line.symbols.end());
-						lines.insert(++copy, next);
-						line.symbols.resize(leave);
+	Size Terminal::Print(int x, int y, int w, int h, int align, const char32_t* str, bool raw, bool measure_only)
+	{
+		return PrintInternal(x, y, w, h, align, str, std::char_traits<char32_t>::length(str), raw, measure_only);
+	}
 
-						break;
-					}
-					else
-					{
-						int relative_index = (s.code & Tileset::kCharOffsetMask);
-						if (relative_index == (int)L' ' || relative_index == (int)L'-')
-						{
-							last_line_break = j;
-						}
-					}
+	Size Terminal::Print(int x, int y, int w, int h, int align, const std::wstring& str, bool raw, bool measure_only)
+	{
+		return PrintInternal(x, y, w, h, align, str.data(), str.length(), raw, measure_only);
+	}
 
-					length += s.spacing.width;
-				}
-			}
-		}
+	template<typename CharT> Size Terminal::PrintInternal(int x0, int y0, int w0, int h0, int align, const CharT* str, size_t length, bool raw, bool measure_only)
+	{
+		Size wrap = Size{w0, h0};
+		MarkupKey key{str, length, m_world.state.font_offset, (std::max)(w0, 0), raw};
 
-		int total_height = 0;
-		int total_width = 0;
-		for (auto& line: lines)
+		// Strings printed or measured over and over (e. g. every frame) are parsed and
+		// wrapped only once. Such strings are not even decoded, the cache is keyed by the
+		// original text. The height limit only clips the result and is not a part of the key.
+		const CompiledText* text = m_markup_cache.Get(key, measure_only);
+		if (!text)
 		{
-			line.UpdateSize();
-			total_height += line.size.height;
-			total_width = (std::max)(total_width, line.size.width);
+			std::wstring& expanded = m_print_scratch.expanded;
+			expanded.clear();
+			DecodeText(str, length, expanded);
+
+			CompiledText& compiled = m_print_scratch.text;
+			CompileText(expanded, key.font_offset, key.width, raw, compiled);
+			if (compiled.cacheable)
+				m_markup_cache.Add(key, compiled);
+			text = &compiled;
 		}
 
+		int total_width = text->size.width;
+		int total_height = text->size.height;
+
 		int horizontal_align = (align & 3);
 		int vertical_align = (align & 12);
 
 		if (!measure_only)
 		{
+			State original_state = m_world.state;
+			Point offset = Point(0, 0);
+			int x, y, w;
+
 			if ((vertical_align & TK_ALIGN_MIDDLE) == TK_ALIGN_MIDDLE)
 			{
 				y = y0 + std::ceil(wrap.height/2.0f - total_height/2.0f);
@@ -1603,7 +2062,7 @@ namespace BearLibTerminal
 			int cutoff_top = y0;
 			int cutoff_bottom = cutoff_top + wrap.height-1;
 
-			for (auto& line: lines)
+			for (auto& line: text->lines)
 			{
 				int line_bottom = y + (line.size.height - 1);
 
@@ -1623,18 +2082,59 @@ namespace BearLibTerminal
 					}
 
 					w = -1;
+					Point shift;
 
-					for (auto& s: line.symbols)
+					for (size_t j = line.first; j < line.last; j++)
 					{
-						if (s.code > 0)
+						const MarkupOp& s = text->ops[j];
+
+						switch (s.kind)
 						{
-							PutInternal(x, y, offset.x, offset.y, s.code, nullptr);
+						case MarkupOp::Symbol:
+							if (x == w) // Proportional symbols may share a cell with the previous one
+							{
+								auto saved = m_world.state.composition;
+								m_world.state.composition = TK_ON;
+								PutInternal(x, y, offset.x + s.offset.x, offset.y + s.offset.y, s.value, nullptr);
+								m_world.state.composition = saved;
+							}
+							else
+							{
+								PutInternal(x, y, offset.x + s.offset.x, offset.y + s.offset.y, s.value, nullptr);
+							}
 							w = x;
+							shift = s.offset;
 							x += s.spacing.width;
-						}
-						else
-						{
-							tags[-s.code]();
+							break;
+						case MarkupOp::Combine:
+							if (w != -1)
+							{
+								auto saved = m_world.state.composition;
+								m_world.state.composition = TK_ON;
+								PutInternal(w, y, offset.x + shift.x, offset.y + shift.y, s.value, nullptr);
+								m_world.state.composition = saved;
+							}
+							break;
+						case MarkupOp::Break:
+							break;
+						case MarkupOp::Color:
+							m_world.state.color = s.value;
+							break;
+						case MarkupOp::BkColor:
+							m_world.state.bkcolor = s.value;
+							break;
+						case MarkupOp::ResetColor:
+							m_world.state.color = original_state.color;
+							break;
+						case MarkupOp::ResetBkColor:
+							m_world.state.bkcolor = original_state.bkcolor;
+							break;
+						case MarkupOp::Offset:
+							offset = s.offset;
+							break;
+						case MarkupOp::ResetOffset:
+							offset = Point(0, 0);
+							break;
 						}
 					}
 				}
@@ -1769,17 +2269,19 @@ namespace BearLibTerminal
 			return 0;
 		}
 
-		if (x < 0 || x >= m_world.stage.size.width || y < 0 || y >= m_world.stage.size.height)
+		Size layer_size = m_world.stage.backbuffer.layers[m_world.state.layer].GetSize();
+		if (x < 0 || x >= layer_size.width || y < 0 || y >= layer_size.height)
 		{
 			LOG(Error, "Invalid location parameters were passed to string reading function");
 			return 0;
 		}
 
-		max = (std::min)(max, m_world.stage.size.width-x);
+		max = (std::min)(max, layer_size.width-x);
 		for (int i=0; i<max; i++)
 		{
 			Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
-			original.push_back(layer.cells[y*m_world.stage.size.width+x+i]);
+			const Cell* cell = layer.Find(x+i, y);
+			original.push_back(cell? *cell: Cell());
 		}
 
 		// Garbage string protection
@@ -1789,7 +2291,7 @@ namespace BearLibTerminal
 
 		auto put_buffer = [&](bool put_cursor)
 		{
-			Print(x, y, 0, 0, TK_ALIGN_DEFAULT, buffer, true, false);
+			PrintInternal(x, y, 0, 0, TK_ALIGN_DEFAULT, buffer, wcslen(buffer), true, false);
 			if (put_cursor && cursor < max) Put(x+cursor, y, m_options.input_cursor_symbol);
 		};
 
@@ -1798,7 +2300,7 @@ namespace BearLibTerminal
 			for (int i = 0; i < max; i++)
 			{
 				Layer& layer = m_world.stage.backbuffer.layers[m_world.state.layer];
-				layer.cells[y*m_world.stage.size.width+x+i] = original[i];
+				layer.MutableAt(x+i, y) = original[i];
 			}
 		};
 
@@ -2119,11 +2621,12 @@ namespace BearLibTerminal
 			glScissor(scissors.left, scissors.top, scissors.width, scissors.height);
 		}
 
-		// Backgrounds
+		// Backgrounds (belong to the first layer and move along with it)
 		Texture::Disable();
 		glBegin(GL_QUADS);
 		{
-			int i = 0, left = 0, top = 0;
+			Point offset = m_world.stage.frontbuffer.layers[0].offset;
+			int i = 0, left = offset.x, top = offset.y;
 			int w = m_world.state.cellsize.width;
 			int h = m_world.state.cellsize.height;
 			for (int y=0; y<m_world.stage.size.height; y++)
@@ -2144,7 +2647,7 @@ namespace BearLibTerminal
 					left += w;
 				}
 
-				left = 0;
+				left = offset.x;
 				top += h;
 			}
 		}
@@ -2159,10 +2662,21 @@ namespace BearLibTerminal
 		AtlasTexture* current_texture = nullptr;
 		auto replacement_tile = GetTileInfo(kUnicodeReplacementCharacter);
 
+		// Animated tiles advance on their own, the scene does not have to change.
+		g_atlas.Animate(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
 		glBegin(GL_QUADS);
 		glColor4f(1, 1, 1, 1);
 		for (auto& layer: m_world.stage.frontbuffer.layers)
 		{
+			// Virtual layers are presented as dense viewports and should never get here.
+			if (layer.IsEmpty() || layer.IsVirtual())
+				continue;
+
+			Size layer_size = layer.GetSize();
+			int width = (std::min)(m_world.stage.size.width, layer_size.width);
+			int height = (std::min)(m_world.stage.size.height, layer_size.height);
+
 			if (layer.crop.Area() > 0)
 			{
 				Rectangle scissors = layer.crop * m_world.state.cellsize / m_stage_area_factor;
@@ -2177,33 +2691,41 @@ namespace BearLibTerminal
 				layer_scissors_applied = true;
 			}
 
-			int i = 0, left = 0, top = 0;
+			int top = layer.offset.y;
 
-			for (int y=0; y<m_world.stage.size.height; y++)
+			for (int y=0; y<height; y++)
 			{
-				for (int x=0; x<m_world.stage.size.width; x++)
+				// Runs of cells in chunks that were never written to are skipped as a whole.
+				for (int x=0, length; x<width; x+=length)
 				{
-					for (auto& leaf: layer.cells[i].leafs)
-					{
-						auto i = g_codespace.find(leaf.code);
-						auto tile = (i == g_codespace.end()? replacement_tile: i->second.get());
+					length = width-x;
+					const Cell* run = layer.FindRun(x, y, length);
+					if (!run)
+						continue;
 
-						if (tile->texture != current_texture)
+					int left = layer.offset.x + x*m_world.state.cellsize.width;
+					for (int i=0; i<length; i++)
+					{
+						for (auto& leaf: run[i].leafs)
 						{
-							glEnd();
-							tile->texture->Bind();
-							current_texture = tile->texture;
-							glBegin(GL_QUADS);
+							auto tile = g_codespace.Get(leaf.code);
+							if (!tile) tile = replacement_tile;
+
+							if (tile->texture != current_texture)
+							{
+								glEnd();
+								tile->texture->Bind();
+								current_texture = tile->texture;
+								glBegin(GL_QUADS);
+							}
+
+							DrawTile(leaf, *tile, left, top, w2, h2);
 						}
 
-						DrawTile(leaf, *tile, left, top, w2, h2);
+						left += m_world.state.cellsize.width;
 					}
-
-					i += 1;
-					left += m_world.state.cellsize.width;
 				}
 
-				left = 0;
 				top += m_world.state.cellsize.height;
 			}
 
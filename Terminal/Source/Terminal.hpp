@@ -29,10 +29,14 @@
 #include "Options.hpp"
 #include "Encoding.hpp"
 #include "OptionGroup.hpp"
+#include "Tileset.hpp"
+#include "Markup.hpp"
 #include "Log.hpp"
 #include <deque>
+#include <list>
 #include <array>
 #include <thread>
+#include <future>
 
 namespace BearLibTerminal
 {
@@ -45,18 +49,31 @@ namespace BearLibTerminal
 		void Refresh();
 		void Clear();
 		void Clear(int x, int y, int w, int h);
+		void Scroll(int x, int y, int w, int h, int dx, int dy);
 		void SetCrop(int x, int y, int w, int h);
 		void SetLayer(int layer_index);
+		void SetLayerOffset(int dx, int dy);
+		void SetLayerSize(int width, int height);
+		void SetLayerOrigin(int x, int y);
+		int SnapshotLayer(int layer_index);
+		void RestoreLayer(int handle);
+		void ReleaseSnapshot(int handle);
 		void SetForeColor(Color color);
 		void SetBackColor(Color color);
 		void SetComposition(int mode);
 		void SetFont(std::wstring name);
 		void Put(int x, int y, int code);
 		void PutExtended(int x, int y, int dx, int dy, int code, Color* corners);
+		void PutArray(int x, int y, int w, int h, const int* codes, const Color* fg, const Color* bg, int stride);
+		void Fill(int x, int y, int w, int h, int code, Color fg, Color bg);
+		void FillBackColor(int x, int y, int w, int h, Color bg);
 		int Pick(int x, int y, int index);
 		Color PickForeColor(int x, int y, int index);
 		Color PickBackColor(int x, int y);
-		Size Print(int x, int y, int w, int h, int align, std::wstring str, bool raw, bool measure_only);
+		Size Print(int x, int y, int w, int h, int align, const char* str, bool raw, bool measure_only); // In terminal.encoding
+		Size Print(int x, int y, int w, int h, int align, const char16_t* str, bool raw, bool measure_only);
+		Size Print(int x, int y, int w, int h, int align, const char32_t* str, bool raw, bool measure_only);
+		Size Print(int x, int y, int w, int h, int align, const std::wstring& str, bool raw, bool measure_only);
 		int HasInput();
 		int GetState(int code);
 		int Read();
@@ -75,6 +92,10 @@ namespace BearLibTerminal
 		bool ParseInputFilter(const std::wstring& s, std::set<int>& out);
 		void ConfigureViewport();
 		void PutInternal(int x, int y, int dx, int dy, char32_t code, Color* colors);
+		template<typename CharT> Size PrintInternal(int x, int y, int w, int h, int align, const CharT* str, size_t length, bool raw, bool measure_only);
+		void DecodeText(const char* str, size_t length, std::wstring& out);
+		template<typename CharT> void DecodeText(const CharT* str, size_t length, std::wstring& out);
+		void CompileText(std::wstring& str, char32_t font_offset, int width, bool raw, CompiledText& text);
 		void ConsumeEvent(Event& event);
 		Event ReadEvent(int timeout);
 		void Render();
@@ -83,6 +104,7 @@ namespace BearLibTerminal
 		void PushEvent(Event event);
 		bool IsEventFiltered(int code);
 		bool HasFilteredInput();
+		void ApplyLoadedTilesets();
 	private:
 		enum state_t {kHidden, kVisible, kClosed} m_state;
 		std::thread::id m_main_thread_id;
@@ -102,6 +124,29 @@ namespace BearLibTerminal
 		Rectangle m_stage_area;
 		SizeF m_stage_area_factor;
 		bool m_alt_pressed; // For alt-functions interception.
+		struct PendingTileset
+		{
+			char32_t offset;
+			bool discarded;
+			std::future<std::shared_ptr<Tileset>> result;
+		};
+		std::list<PendingTileset> m_pending_tilesets; // Loading with 'async' attribute
+		MarkupCache m_markup_cache;
+		struct PrintScratch // Reused by every Print so that it does not allocate once warmed up
+		{
+			CompiledText text;
+			std::vector<CompiledText::Line> lines;
+			std::wstring expanded, name, params, value;
+		};
+		PrintScratch m_print_scratch;
+		struct Snapshot
+		{
+			int layer;
+			Layer contents; // Shares the cells with the layer until either is modified
+			std::vector<Color> background; // Only for the first layer
+		};
+		std::map<int, Snapshot> m_snapshots;
+		int m_last_snapshot;
 	};
 
 	extern std::unique_ptr<Terminal> g_instance;
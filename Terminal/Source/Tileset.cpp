@@ -33,12 +33,14 @@
 
 namespace BearLibTerminal
 {
-	std::unordered_map<char32_t, std::shared_ptr<TileInfo>> g_codespace;
-
 	std::map<char32_t, std::shared_ptr<Tileset>> g_tilesets;
 
 	std::shared_ptr<Tileset> g_dynamic_tileset;
 
+	// Dynamic tileset of the previous cell size. Keeping it around makes switching
+	// back and forth between two sizes (e.g. zooming) free of re-generation.
+	std::shared_ptr<DynamicTileset> g_previous_dynamic_tileset;
+
 	std::string GuessResourceFormat(const std::vector<uint8_t>& data)
 	{
 		auto compare = [&data](const char* magic, size_t size) -> bool
@@ -78,6 +80,16 @@ namespace BearLibTerminal
 		return m_spacing;
 	}
 
+	int Tileset::GetAdvance(char32_t)
+	{
+		return 0;
+	}
+
+	int Tileset::GetKerning(char32_t, char32_t)
+	{
+		return 0;
+	}
+
 	bool Tileset::Provides(char32_t code)
 	{
 		return m_cache.find(code) != m_cache.end();
@@ -157,41 +169,65 @@ namespace BearLibTerminal
 		return (offset & kCharOffsetMask) == 0;
 	}
 
+	void MapTile(char32_t code, TileInfo* tile)
+	{
+		g_codespace.Set(code, tile);
+		tile->tileset->m_mapped_codes.insert(code);
+		g_atlas.Add(tile);
+	}
+
 	void AddTileset(std::shared_ptr<Tileset> tileset)
 	{
 		char32_t offset = tileset->GetOffset();
+		char32_t font_high = (offset & Tileset::kFontOffsetMask) + Tileset::kCharOffsetMask;
 		g_tilesets[offset] = tileset;
 
-		for (auto i = g_codespace.begin(); i != g_codespace.end(); )
+		// The new tileset overrides codes at and above its offset (within the same font)
+		// that are currently provided by tilesets with lower offsets.
+		std::vector<TileInfo*> evicted;
+		auto evict = [&](Tileset& lower)
 		{
-			if (i->first >= offset && i->second->tileset->GetOffset() < offset && tileset->Provides(i->first))
-			{
-				i->second->texture->Remove(i->second, true);
-				i = g_codespace.erase(i);
-			}
-			else
+			auto& codes = lower.m_mapped_codes;
+			for (auto i = codes.lower_bound(offset); i != codes.end() && *i <= font_high; )
 			{
-				i++;
+				if (tileset->Provides(*i))
+				{
+					evicted.push_back(g_codespace.Get(*i));
+					g_codespace.Erase(*i);
+					i = codes.erase(i);
+				}
+				else
+				{
+					i++;
+				}
 			}
-		}
+		};
+
+		for (auto i = g_tilesets.lower_bound(offset & Tileset::kFontOffsetMask); i != g_tilesets.end() && i->first < offset; i++)
+			evict(*i->second);
+
+		// Dynamic tiles are the last resort for any font.
+		if (g_dynamic_tileset)
+			evict(*g_dynamic_tileset);
+
+		g_atlas.Remove(evicted, true);
 	}
 
 	void RemoveTileset(std::shared_ptr<Tileset> tileset)
 	{
-		for (auto i = g_codespace.begin(); i != g_codespace.end(); )
+		std::vector<TileInfo*> evicted;
+		for (char32_t code: tileset->m_mapped_codes)
 		{
-			if (i->second->tileset == tileset.get())
-			{
-				i->second->texture->Remove(i->second);
-				i = g_codespace.erase(i);
-			}
-			else
-			{
-				i++;
-			}
+			if (TileInfo* tile = g_codespace.Get(code))
+				evicted.push_back(tile);
+			g_codespace.Erase(code);
 		}
+		tileset->m_mapped_codes.clear();
+		g_atlas.Remove(evicted);
 
-		g_tilesets.erase(tileset->GetOffset());
+		auto i = g_tilesets.find(tileset->GetOffset());
+		if (i != g_tilesets.end() && i->second == tileset)
+			g_tilesets.erase(i);
 	}
 
 	void RemoveTileset(char32_t offset)
@@ -203,11 +239,31 @@ namespace BearLibTerminal
 
 	void UpdateDynamicTileset(Size cell_size)
 	{
-		if (g_dynamic_tileset)
+		auto current = std::static_pointer_cast<DynamicTileset>(g_dynamic_tileset);
+		std::vector<char32_t> codes;
+
+		if (current)
 		{
-			RemoveTileset(g_dynamic_tileset);
+			codes.assign(current->m_mapped_codes.begin(), current->m_mapped_codes.end());
+			RemoveTileset(current);
+		}
+
+		if (!current || current->GetBoundingBoxSize() != cell_size)
+		{
+			if (g_previous_dynamic_tileset && g_previous_dynamic_tileset->GetBoundingBoxSize() == cell_size)
+			{
+				std::swap(current, g_previous_dynamic_tileset);
+			}
+			else
+			{
+				g_previous_dynamic_tileset = current;
+				current = std::make_shared<DynamicTileset>(0xFFFFFF, cell_size);
+			}
 		}
 
-		g_dynamic_tileset = std::make_shared<DynamicTileset>(0xFFFFFF, cell_size);
+		// Regenerate the tiles that were in use in one batch instead of one by one
+		// as they are drawn. Tiles already cached for this size are reused as is.
+		current->Prepare(codes);
+		g_dynamic_tileset = current;
 	}
 }
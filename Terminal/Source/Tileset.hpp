@@ -24,12 +24,17 @@
 #define BEARLIBTERMINAL_TILESET_HPP
 
 #include "Atlas.hpp"
+#include "Codespace.hpp"
 #include "OptionGroup.hpp"
 #include <memory>
+#include <vector>
 #include <map>
+#include <set>
 
 namespace BearLibTerminal
 {
+	class DynamicTileset;
+
 	class Tileset
 	{
 	public:
@@ -40,6 +45,8 @@ namespace BearLibTerminal
 		virtual std::shared_ptr<TileInfo> Get(char32_t code);
 		virtual Size GetBoundingBoxSize() = 0; // FIXME: refactor to tile property
 		virtual Size GetSpacing() const;
+		virtual int GetAdvance(char32_t code); // In 1/64 of a pixel; 0 if tiles are placed on the cell grid
+		virtual int GetKerning(char32_t left, char32_t right); // In 1/64 of a pixel
 
 		static const char32_t kFontOffsetMultiplier = 0x01000000;
 		static const char32_t kFontOffsetMask = 0xFF000000;
@@ -51,14 +58,26 @@ namespace BearLibTerminal
 		char32_t m_offset;
 		std::unordered_map<char32_t, std::shared_ptr<TileInfo>> m_cache;
 		Size m_spacing;
-	};
 
-	extern std::unordered_map<char32_t, std::shared_ptr<TileInfo>> g_codespace;
+	private:
+		// Codes of this tileset's tiles currently present in g_codespace. Ordered
+		// so that a range of codes can be looked up without scanning everything.
+		std::set<char32_t> m_mapped_codes;
+
+		friend void MapTile(char32_t code, TileInfo* tile);
+		friend void AddTileset(std::shared_ptr<Tileset> tileset);
+		friend void RemoveTileset(std::shared_ptr<Tileset> tileset);
+		friend void UpdateDynamicTileset(Size cell_size);
+	};
 
 	extern std::map<char32_t, std::shared_ptr<Tileset>> g_tilesets;
 
 	extern std::shared_ptr<Tileset> g_dynamic_tileset;
 
+	extern std::shared_ptr<DynamicTileset> g_previous_dynamic_tileset;
+
+	void MapTile(char32_t code, TileInfo* tile);
+
 	void AddTileset(std::shared_ptr<Tileset> tileset);
 
 	void RemoveTileset(std::shared_ptr<Tileset> tileset);
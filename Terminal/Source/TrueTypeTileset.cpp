@@ -25,21 +25,153 @@
 #include "Utility.hpp"
 #include "Log.hpp"
 #include <cmath>
+#include <unordered_map>
 #include <freetype/ftlcdfil.h>
 #include <freetype/ftglyph.h>
+#include <freetype/ftsizes.h>
+#include <freetype/ftoutln.h>
 
 namespace BearLibTerminal
 {
+	// Guards the shared FT_Library with everything made from it and the registry
+	// itself. Recursive since the last reference to a face may be dropped while
+	// the registry is being looked up.
+	static std::recursive_mutex g_font_registry_lock;
+	static std::weak_ptr<FT_Library> g_font_library;
+	static std::unordered_multimap<uint64_t, std::weak_ptr<FontFace>> g_font_registry;
+
+	// Glyphs are rendered with this much horizontal oversampling, scaled back by the face transform.
+	static const int kHorizontalResolution = 64;
+
+	static FT_Matrix GetFaceTransform()
+	{
+		return FT_Matrix
+		{
+			(int)((1.0/kHorizontalResolution) * 0x10000L),
+			(int)((0.0)                       * 0x10000L),
+			(int)((0.0)                       * 0x10000L),
+			(int)((1.0)                       * 0x10000L)
+		};
+	}
+
+	static uint64_t HashFontData(const std::vector<uint8_t>& data)
+	{
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ULL;
+		for (uint8_t byte: data)
+			hash = (hash ^ byte) * 1099511628211ULL;
+		return hash;
+	}
+
+	FontFace::~FontFace()
+	{
+		std::lock_guard<std::recursive_mutex> guard(g_font_registry_lock);
+		FT_Done_Face(face);
+		library.reset();
+	}
+
+	void FontFace::EnableLcdFilter()
+	{
+		std::lock_guard<std::recursive_mutex> guard(g_font_registry_lock);
+		FT_Library_SetLcdFilter(*library, FT_LCD_FILTER_DEFAULT);
+		FT_Library_SetLcdFilterWeights(*library, (unsigned char*)"\x20\x70\x70\x70\x20");
+	}
+
+	std::recursive_mutex& FontFace::GetLock()
+	{
+		return g_font_registry_lock;
+	}
+
+	const FontFace::Outline& FontFace::GetOutline(FT_UInt index)
+	{
+		auto i = outlines.find(index);
+		if (i != outlines.end())
+			return i->second;
+
+		Outline outline;
+		if (FT_Load_Glyph(face, index, FT_LOAD_NO_SCALE | FT_LOAD_NO_RECURSE | FT_LOAD_IGNORE_TRANSFORM))
+			throw std::runtime_error("TrueTypeTileset: can't load glyph outline");
+		outline.composite = face->glyph->format == FT_GLYPH_FORMAT_COMPOSITE;
+
+		if (FT_Load_Glyph(face, index, FT_LOAD_NO_SCALE | FT_LOAD_IGNORE_TRANSFORM) || face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+			throw std::runtime_error("TrueTypeTileset: can't load glyph outline");
+
+		const FT_Outline& source = face->glyph->outline;
+		outline.first_point = outline_points.size();
+		outline.first_contour = outline_contours.size();
+		outline.n_points = source.n_points;
+		outline.n_contours = source.n_contours;
+		outline.flags = source.flags;
+		outline.advance = face->glyph->metrics.horiAdvance;
+
+		outline_points.insert(outline_points.end(), source.points, source.points + source.n_points);
+		outline_tags.insert(outline_tags.end(), source.tags, source.tags + source.n_points);
+		outline_contours.insert(outline_contours.end(), source.contours, source.contours + source.n_contours);
+
+		return outlines[index] = outline;
+	}
+
+	std::shared_ptr<FontFace> FontFace::Open(std::vector<uint8_t> data)
+	{
+		std::lock_guard<std::recursive_mutex> guard(g_font_registry_lock);
+
+		uint64_t hash = HashFontData(data);
+		auto range = g_font_registry.equal_range(hash);
+		for (auto i = range.first; i != range.second; )
+		{
+			if (auto font = i->second.lock())
+			{
+				if (font->data == data)
+				{
+					LOG(Trace, "FontFace: reusing already loaded font");
+					return font;
+				}
+				i++;
+			}
+			else
+			{
+				i = g_font_registry.erase(i);
+			}
+		}
+
+		auto library = g_font_library.lock();
+		if (!library)
+		{
+			library = std::shared_ptr<FT_Library>(
+				new FT_Library(),
+				[](FT_Library* p){FT_Done_FreeType(*p); delete p;}
+			);
+			if (FT_Init_FreeType(library.get()))
+			{
+				*library = nullptr;
+				throw std::runtime_error("TrueTypeTileset: can't initialize Freetype");
+			}
+			g_font_library = library;
+		}
+
+		auto font = std::make_shared<FontFace>();
+		font->data = std::move(data);
+		if (FT_New_Memory_Face(*library, &font->data[0], font->data.size(), 0, &font->face))
+		{
+			font->face = nullptr;
+			throw std::runtime_error("TrueTypeTileset: can't load font from buffer");
+		}
+		font->library = library;
+
+		g_font_registry.insert(std::make_pair(hash, std::weak_ptr<FontFace>(font)));
+		return font;
+	}
+
 	TrueTypeTileset::TrueTypeTileset(char32_t offset, std::vector<uint8_t> data, OptionGroup& options):
 		Tileset(offset),
 		m_alignment(TileAlignment::Center),
-		m_font_data(std::move(data)),
-		m_font_library(nullptr),
-		m_font_face(nullptr),
+		m_font_size(nullptr),
 		m_render_mode(FT_RENDER_MODE_NORMAL),
 		m_hinting(FT_LOAD_DEFAULT),
 		m_use_box_drawing(false),
-		m_use_block_elements(false)
+		m_use_block_elements(false),
+		m_use_outline_cache(false),
+		m_proportional(false)
 	{
 		if (options.attributes.count(L"spacing") && !try_parse(options.attributes[L"spacing"], m_spacing))
 			throw std::runtime_error("TrueTypeTileset: failed to parse 'spacing' attribute");
@@ -70,6 +202,9 @@ namespace BearLibTerminal
 				throw std::runtime_error("TrueTypeTileset: failed to parse 'mode' attribute");
 		}
 
+		// Only 'none' lets glyphs be rendered from the outlines the face keeps (see
+		// m_use_outline_cache below), so with the default 'normal' hinting every
+		// change of the cell size loads and hints each glyph anew.
 		if (options.attributes.count(L"hinting"))
 		{
 			std::wstring mode_str = options.attributes[L"hinting"];
@@ -107,36 +242,30 @@ namespace BearLibTerminal
 		if (options.attributes.count(L"use-block-elements") && !try_parse(options.attributes[L"use-block-elements"], m_use_block_elements))
 			throw std::runtime_error("TrueTypeTileset: failed to parse 'use-block-elements' attribute");
 
-		// Trying to initialize FreeType
-		m_font_library = std::shared_ptr<FT_Library>(
-			new FT_Library(),
-			[](FT_Library* p){FT_Done_FreeType(*p); delete p;}
-		);
-		if (FT_Init_FreeType(m_font_library.get()))
-			throw std::runtime_error("TrueTypeTileset: can't initialize Freetype");
-
-		m_font_face = std::shared_ptr<FT_Face>(
-			new FT_Face(),
-			[](FT_Face* p){FT_Done_Face(*p); delete p;}
-		);
-		if (FT_New_Memory_Face(*m_font_library, &m_font_data[0], m_font_data.size(), 0, m_font_face.get()))
-			throw std::runtime_error("TrueTypeTileset: can't load font from buffer");
+		if (options.attributes.count(L"proportional") && !try_parse(options.attributes[L"proportional"], m_proportional))
+			throw std::runtime_error("TrueTypeTileset: failed to parse 'proportional' attribute");
 
-		int hres = 64;
-		FT_Matrix matrix =
-		{
-			(int)((1.0/hres) * 0x10000L),
-			(int)((0.0)      * 0x10000L),
-			(int)((0.0)      * 0x10000L),
-			(int)((1.0)      * 0x10000L)
-		};
-		FT_Set_Transform(*m_font_face, &matrix, NULL);
+		// Proportional glyphs are positioned by their origin, which is at the left of the cell.
+		if (m_proportional)
+			m_alignment = TileAlignment::TopLeft;
+
+		// The same font at several sizes shares the library, data and face.
+		m_font = FontFace::Open(std::move(data));
+		FT_Face& face = m_font->face;
+		std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
+
+		if (FT_New_Size(face, &m_font_size) || FT_Activate_Size(m_font_size))
+			throw std::runtime_error("TrueTypeTileset: can't create font size object");
+
+		int hres = kHorizontalResolution;
+		FT_Matrix matrix = GetFaceTransform();
+		FT_Set_Transform(face, &matrix, NULL);
 
 		auto get_metrics = [&](char32_t code) -> FT_Glyph_Metrics
 		{
-			if (FT_Load_Glyph(*m_font_face, FT_Get_Char_Index(*m_font_face, code), 0))
+			if (FT_Load_Glyph(face, FT_Get_Char_Index(face, code), 0))
 				throw std::runtime_error("TrueTypeTileset: glyph loading error");
-			return (*m_font_face)->glyph->metrics;
+			return face->glyph->metrics;
 		};
 
 		char32_t reference_code = m_codepage->Convert((int)'@');
@@ -153,14 +282,14 @@ namespace BearLibTerminal
 		{
 			// Only height was specified, e. g. size=12
 
-			if (FT_Set_Char_Size(*m_font_face, 0, (uint32_t)(m_tile_size.height*64), 96*hres, 96))
+			if (FT_Set_Char_Size(face, 0, (uint32_t)(m_tile_size.height*64), 96*hres, 96))
 				throw std::runtime_error("TrueTypeTileset: can't setup font size");
 
 			int dot_width = (int)std::ceil(get_metrics('.').horiAdvance/64.0f/64.0f);
 			int at_width = (int)std::ceil(get_metrics(reference_code).horiAdvance/64.0f/64.0f);
 			m_monospace = dot_width == at_width;
 
-			int height = (*m_font_face)->size->metrics.height >> 6;
+			int height = face->size->metrics.height >> 6;
 			int width = at_width;
 
 			m_tile_size = Size(width, height);
@@ -174,11 +303,11 @@ namespace BearLibTerminal
 
 			auto get_size = [&](float height) -> Size
 			{
-				if (FT_Set_Char_Size(*m_font_face, 0, (uint32_t)(height*64), 96*hres, 96))
+				if (FT_Set_Char_Size(face, 0, (uint32_t)(height*64), 96*hres, 96))
 					throw std::runtime_error("TrueTypeTileset: can't setup font size");
 
 				int w = (int)std::ceil(get_metrics(reference_code).horiAdvance/64.0f/64.0f);
-				int h = (*m_font_face)->size->metrics.height >> 6;
+				int h = face->size->metrics.height >> 6;
 
 				return Size{w, h};
 			};
@@ -220,7 +349,7 @@ namespace BearLibTerminal
 			int at_width = (int)std::ceil(get_metrics(reference_code).horiAdvance/64.0f/64.0f);
 			m_monospace = dot_width == at_width;
 
-			//int height = (*m_font_face)->size->metrics.height >> 6;
+			//int height = face->size->metrics.height >> 6;
 			//int width = at_width;
 
 			LOG(Trace, "Font tile size is " << m_tile_size << ", font is " << (m_monospace? "monospace": "not monospace"));
@@ -228,16 +357,101 @@ namespace BearLibTerminal
 
 		if (m_render_mode == FT_RENDER_MODE_LCD)
 		{
-			FT_Library_SetLcdFilter(*m_font_library, FT_LCD_FILTER_DEFAULT);
-			FT_Library_SetLcdFilterWeights(*m_font_library, (unsigned char*)"\x20\x70\x70\x70\x20");
+			m_font->EnableLcdFilter();
 		}
 
 		if (m_alignment == TileAlignment::Unknown)
 			m_alignment = TileAlignment::Center;
+
+		// Unhinted outlines do not depend on the size, so the face keeps them once
+		// decoded and every size only scales and rasterizes them. Hinted outlines are
+		// grid-fitted for a particular size and are always loaded anew; that includes
+		// light hinting, which still snaps the outline vertically. Scaling matches
+		// what the TrueType driver does at load time, the only outline driver built.
+		m_use_outline_cache =
+			m_hinting == FT_LOAD_NO_HINTING &&
+			m_render_mode == FT_RENDER_MODE_NORMAL &&
+			FT_IS_SCALABLE(face) &&
+			!FT_HAS_FIXED_SIZES(face);
+	}
+
+	TrueTypeTileset::~TrueTypeTileset()
+	{
+		if (m_font_size)
+		{
+			std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
+			FT_Done_Size(m_font_size);
+		}
+	}
+
+	bool TrueTypeTileset::RenderCachedOutline(FT_UInt index, FT_Bitmap& bitmap, FT_Glyph_Metrics& metrics, std::vector<uint8_t>& buffer)
+	{
+		const FontFace::Outline& cached = m_font->GetOutline(index);
+		if (cached.composite)
+			return false;
+
+		FT_Fixed x_scale = m_font_size->metrics.x_scale;
+		FT_Fixed y_scale = m_font_size->metrics.y_scale;
+
+		std::vector<FT_Vector> points(cached.n_points);
+		for (int i = 0; i < cached.n_points; i++)
+		{
+			const FT_Vector& point = m_font->outline_points[cached.first_point + i];
+			points[i].x = FT_MulFix(point.x, x_scale);
+			points[i].y = FT_MulFix(point.y, y_scale);
+		}
+
+		FT_Outline outline;
+		outline.n_points = cached.n_points;
+		outline.n_contours = cached.n_contours;
+		outline.points = points.empty()? nullptr: &points[0];
+		outline.tags = cached.n_points? &m_font->outline_tags[cached.first_point]: nullptr;
+		outline.contours = cached.n_contours? &m_font->outline_contours[cached.first_contour]: nullptr;
+		outline.flags = cached.flags;
+
+		// Same metrics FT_Load_Glyph reports for an unhinted glyph (before the face transform).
+		FT_BBox bbox;
+		FT_Outline_Get_CBox(&outline, &bbox);
+		metrics = FT_Glyph_Metrics();
+		metrics.width = bbox.xMax - bbox.xMin;
+		metrics.height = bbox.yMax - bbox.yMin;
+		metrics.horiBearingX = bbox.xMin;
+		metrics.horiBearingY = bbox.yMax;
+		metrics.horiAdvance = FT_MulFix(cached.advance, x_scale);
+
+		FT_Matrix matrix = GetFaceTransform();
+		FT_Outline_Transform(&outline, &matrix);
+
+		// Grid-fitted control box, as the smooth renderer does.
+		FT_Outline_Get_CBox(&outline, &bbox);
+		bbox.xMin &= ~63;
+		bbox.yMin &= ~63;
+		bbox.xMax = (bbox.xMax + 63) & ~63;
+		bbox.yMax = (bbox.yMax + 63) & ~63;
+
+		bitmap = FT_Bitmap();
+		bitmap.width = (bbox.xMax - bbox.xMin) >> 6;
+		bitmap.rows = (bbox.yMax - bbox.yMin) >> 6;
+		bitmap.pitch = bitmap.width;
+		bitmap.num_grays = 256;
+		bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+
+		if (bitmap.width > 0 && bitmap.rows > 0)
+		{
+			buffer.assign(bitmap.pitch * bitmap.rows, 0);
+			bitmap.buffer = &buffer[0];
+			FT_Outline_Translate(&outline, -bbox.xMin, -bbox.yMin);
+			if (FT_Outline_Get_Bitmap(*m_font->library, &outline, &bitmap))
+				throw std::runtime_error("TrueTypeTileset: can't render glyph");
+		}
+
+		return true;
 	}
 
 	FT_UInt TrueTypeTileset::GetGlyphIndex(char32_t code)
 	{
+		FT_Face& face = m_font->face;
+
 		if (code < m_offset)
 			return 0;
 
@@ -245,7 +459,7 @@ namespace BearLibTerminal
 		{
 			// Font
 			char32_t char_code = (code & Tileset::kCharOffsetMask);
-			return FT_Get_Char_Index(*m_font_face, char_code);
+			return FT_Get_Char_Index(face, char_code);
 		}
 		else
 		{
@@ -254,7 +468,7 @@ namespace BearLibTerminal
 			char32_t char_code = m_codepage->Convert(index);
 			if (char_code == kUnicodeReplacementCharacter)
 				return 0;
-			return FT_Get_Char_Index(*m_font_face, char_code);
+			return FT_Get_Char_Index(face, char_code);
 		}
 	}
 
@@ -271,6 +485,7 @@ namespace BearLibTerminal
 			}
 		}
 
+		std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
 		return GetGlyphIndex(code) > 0;
 	}
 
@@ -279,47 +494,59 @@ namespace BearLibTerminal
 		if (auto cached = Tileset::Get(code))
 			return cached;
 
+		FT_Face& face = m_font->face;
+		std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
+		FT_Activate_Size(m_font_size);
+
 		FT_UInt index = GetGlyphIndex(code);
 		if (index == 0)
 			throw std::runtime_error("TrueTypeTileset: request for a tile that is not provided by the tileset");
 
-		if (FT_Load_Glyph(*m_font_face, index, m_hinting))
-			throw std::runtime_error("TrueTypeTileset: can't load character glyph");
+		FT_Bitmap bitmap;
+		FT_Glyph_Metrics metrics;
+		std::vector<uint8_t> buffer; // Pixels of a glyph rendered from a cached outline
 
-		if ((*m_font_face)->glyph->format != FT_GLYPH_FORMAT_BITMAP)
+		if (!m_use_outline_cache || !RenderCachedOutline(index, bitmap, metrics, buffer))
 		{
-			FT_Render_Mode render_mode = m_render_mode;
+			if (FT_Load_Glyph(face, index, m_hinting))
+				throw std::runtime_error("TrueTypeTileset: can't load character glyph");
 
-			if (FT_Render_Glyph((*m_font_face)->glyph, render_mode) != 0)
+			if (face->glyph->format != FT_GLYPH_FORMAT_BITMAP)
 			{
-				throw std::runtime_error("TrueTypeTileset: can't render glyph");
+				FT_Render_Mode render_mode = m_render_mode;
+
+				if (FT_Render_Glyph(face->glyph, render_mode) != 0)
+				{
+					throw std::runtime_error("TrueTypeTileset: can't render glyph");
+				}
 			}
-		}
 
-		FT_GlyphSlot& slot = (*m_font_face)->glyph;
+			bitmap = face->glyph->bitmap;
+			metrics = face->glyph->metrics;
+		}
 
-		int rows = slot->bitmap.rows;
+		int rows = bitmap.rows;
 		int columns = 0;
 		int pixel_size = 0;
 
-		int height = (*m_font_face)->size->metrics.height >> 6;
-		int descender = (*m_font_face)->size->metrics.descender >> 6;
-		int bx = (slot->metrics.horiBearingX >> 6) / 64;
-		int by = slot->metrics.horiBearingY >> 6;
+		int height = face->size->metrics.height >> 6;
+		int descender = face->size->metrics.descender >> 6;
+		int bx = (metrics.horiBearingX >> 6) / 64;
+		int by = metrics.horiBearingY >> 6;
 
-		if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_GRAY)
+		if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY)
 		{
-			columns = slot->bitmap.width;
+			columns = bitmap.width;
 			pixel_size = 1;
 		}
-		else if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
+		else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
 		{
-			columns = slot->bitmap.width/3;
+			columns = bitmap.width/3;
 			pixel_size = 3;
 		}
-		else if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+		else if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
 		{
-			columns = slot->bitmap.width;
+			columns = bitmap.width;
 			pixel_size = 0;
 		}
 
@@ -329,31 +556,31 @@ namespace BearLibTerminal
 		{
 			for (int x = 0; x < columns; x++)
 			{
-				uint8_t* p = slot->bitmap.buffer + y*slot->bitmap.pitch + x*pixel_size;
-				if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_GRAY)
+				uint8_t* p = bitmap.buffer + y*bitmap.pitch + x*pixel_size;
+				if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY)
 				{
 					Color c(p[0], 255, 255, 255);
 					glyph(x, y) = c;
 				}
-				else if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
+				else if (bitmap.pixel_mode == FT_PIXEL_MODE_LCD)
 				{
 					Color c(255, p[0], p[1], p[2]);
 					glyph(x, y) = c;
 				}
-				else if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+				else if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
 				{
 					int j = x%8;
 					int i = (x-j)/8;
-					uint8_t byte = *(slot->bitmap.buffer + y*slot->bitmap.pitch + i);
+					uint8_t byte = *(bitmap.buffer + y*bitmap.pitch + i);
 					uint8_t alpha = (byte & (1 << (7-j)))? 255: 0;
 					glyph(x, y) = Color(alpha, 255, 255, 255);
 				}
 			}
 		}
 
-		int descender2 = (*m_font_face)->size->metrics.descender >> 6;
-		float wff = slot->metrics.horiAdvance / 4096.0f;
-		float hff = (*m_font_face)->size->metrics.height / 64.0f;
+		int descender2 = face->size->metrics.descender >> 6;
+		float wff = metrics.horiAdvance / 4096.0f;
+		float hff = face->size->metrics.height / 64.0f;
 		int dy = -((by-descender2) - hff/2);
 		Point offset;
 		if (m_alignment == TileAlignment::Center)
@@ -368,7 +595,7 @@ namespace BearLibTerminal
 		}
 		else
 		{
-			if (m_monospace)
+			if (m_monospace || m_proportional)
 				offset = Point(bx, m_tile_size.height/2+dy);
 			else
 				offset = Point(m_tile_size.width/2-(columns+bx)/2, m_tile_size.height/2+dy);
@@ -389,5 +616,45 @@ namespace BearLibTerminal
 	{
 		return m_tile_size;
 	}
+
+	int TrueTypeTileset::GetAdvance(char32_t code)
+	{
+		if (!m_proportional)
+			return 0;
+
+		std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
+		auto i = m_advances.find(code);
+		if (i != m_advances.end())
+			return i->second;
+
+		FT_Face& face = m_font->face;
+		FT_Activate_Size(m_font_size);
+
+		// Metrics are not affected by the face transform, so horizontally they are
+		// still at kHorizontalResolution times the actual resolution.
+		int advance = m_tile_size.width * 64;
+		if (!FT_Load_Glyph(face, GetGlyphIndex(code), m_hinting))
+			advance = face->glyph->metrics.horiAdvance / kHorizontalResolution;
+
+		advance = (std::max)(advance, 1);
+		m_advances[code] = advance;
+		return advance;
+	}
+
+	int TrueTypeTileset::GetKerning(char32_t left, char32_t right)
+	{
+		FT_Face& face = m_font->face;
+		if (!m_proportional || !FT_HAS_KERNING(face))
+			return 0;
+
+		std::lock_guard<std::recursive_mutex> guard(FontFace::GetLock());
+		FT_Activate_Size(m_font_size);
+
+		FT_Vector delta;
+		if (FT_Get_Kerning(face, GetGlyphIndex(left), GetGlyphIndex(right), FT_KERNING_UNFITTED, &delta))
+			return 0;
+
+		return delta.x / kHorizontalResolution;
+	}
 }
 
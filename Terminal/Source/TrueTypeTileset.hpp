@@ -24,6 +24,8 @@
 #define TRUETYPETILESET_HPP_
 
 #include <vector>
+#include <unordered_map>
+#include <mutex>
 #include <stdint.h>
 #include "Tileset.hpp"
 #include "Encoding.hpp"
@@ -33,27 +35,66 @@
 
 namespace BearLibTerminal
 {
+	// A font loaded into FreeType, shared by all TrueType tilesets made from the
+	// same font data. Every tileset renders through its own FT_Size object.
+	// All faces share one FT_Library, which is not safe to use from several
+	// threads at once, so any FreeType call must be made under GetLock().
+	struct FontFace
+	{
+		// Unscaled (font units) glyph outline stored in the shared arrays below.
+		struct Outline
+		{
+			size_t first_point;
+			size_t first_contour;
+			short n_points;
+			short n_contours;
+			int flags;
+			FT_Pos advance;
+			bool composite; // Component offsets are grid-fitted at load, can't be reused
+		};
+
+		~FontFace();
+		void EnableLcdFilter();
+		const Outline& GetOutline(FT_UInt index);
+		static std::shared_ptr<FontFace> Open(std::vector<uint8_t> data);
+		static std::recursive_mutex& GetLock();
+
+		std::shared_ptr<FT_Library> library;
+		std::vector<uint8_t> data;
+		FT_Face face;
+		std::unordered_map<FT_UInt, Outline> outlines;
+		std::vector<FT_Vector> outline_points;
+		std::vector<char> outline_tags;
+		std::vector<short> outline_contours;
+	};
+
 	class TrueTypeTileset: public Tileset
 	{
 	public:
 		TrueTypeTileset(char32_t offset, std::vector<uint8_t> data, OptionGroup& options);
+		~TrueTypeTileset();
 		bool Provides(char32_t code);
 		std::shared_ptr<TileInfo> Get(char32_t code);
 		Size GetBoundingBoxSize();
+		int GetAdvance(char32_t code);
+		int GetKerning(char32_t left, char32_t right);
 
 	private:
 		FT_UInt GetGlyphIndex(char32_t code);
+		bool RenderCachedOutline(FT_UInt index, FT_Bitmap& bitmap, FT_Glyph_Metrics& metrics, std::vector<uint8_t>& buffer);
 		Size m_tile_size;
 		TileAlignment m_alignment;
 		std::unique_ptr<Encoding8> m_codepage;
-		std::vector<uint8_t> m_font_data;
-		std::shared_ptr<FT_Library> m_font_library;
-		std::shared_ptr<FT_Face> m_font_face;
+		std::shared_ptr<FontFace> m_font;
+		FT_Size m_font_size;
 		FT_Render_Mode m_render_mode;
 		FT_Int32 m_hinting;
 		bool m_monospace;
 		bool m_use_box_drawing;
 		bool m_use_block_elements;
+		bool m_use_outline_cache;
+		bool m_proportional; // Symbols are placed by their advances, see Tileset::GetAdvance
+		std::unordered_map<char32_t, int> m_advances;
 	};
 }
 